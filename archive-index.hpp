@@ -0,0 +1,315 @@
+/*
+   Binary symbol index of an archive as written by ulmranlib_mkindex -b
+   into the __SYMTAB_INDEX member, an alternative to the textual index
+   with its "kind ident member" lines:
+
+      arindex::builder index;
+      auto m = index.add_member(name, header_offset, size);
+      index.add_symbol(symbol, m);	// first definition wins
+      std::string data = index.data();
+
+      arindex::table index;
+      if (index.open(data)) {
+	 if (auto m = index.find(symbol)) {
+	    // index.member_offset(*m) etc.
+	 }
+      }
+
+   Members are numbered in the order they were added. Symbols are found
+   by a hash table with open addressing, i.e. in constant time without
+   scanning or tokenizing the index. All numbers are little endian:
+
+      offset  size
+	   0     8  magic "\177ULMIDX\0"
+	   8     4  version
+	  12     4  number of buckets (power of 2)
+	  16     4  number of symbols
+	  20     4  number of members
+	  24     8  size of the string table
+	  32        buckets: index of symbol + 1 (0 if empty), 4 bytes each
+		    symbols: hash, name offset, name length, member (4 each)
+		    members: header offset within the archive, size (8 each),
+			     name offset, name length (4 each)
+		    string table
+
+   The member names permit to check the offsets which become stale if
+   the archive is modified afterwards.
+*/
+
+#ifndef ARCHIVE_INDEX_HPP
+#define ARCHIVE_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "binary-codec.hpp"
+
+namespace arindex {
+
+constexpr char magic[8] = { '\177', 'U', 'L', 'M', 'I', 'D', 'X', '\0' };
+constexpr std::uint32_t version = 1;
+constexpr std::size_t header_size = 32;
+constexpr std::size_t symbol_size = 16;
+constexpr std::size_t member_size = 24;
+
+inline bool
+is_index(std::string_view data)
+{
+    return data.substr(0, sizeof(magic)) ==
+	   std::string_view(magic, sizeof(magic));
+}
+
+class builder
+{
+  public:
+    std::uint32_t
+    add_member(std::string_view name, std::uint64_t offset,
+	       std::uint64_t size)
+    {
+	members.push_back({ std::string(name), offset, size });
+	return static_cast<std::uint32_t>(members.size() - 1);
+    }
+
+    /* later definitions of an already added symbol are ignored */
+    void
+    add_symbol(std::string_view name, std::uint32_t member)
+    {
+	if (known.emplace(std::string(name), member).second) {
+	    symbols.push_back({ std::string(name), member });
+	}
+    }
+
+    std::string
+    data() const
+    {
+	using codec::put_uint;
+
+	std::uint32_t num_buckets = 1;
+	while (num_buckets < 2 * symbols.size()) {
+	    num_buckets *= 2;
+	}
+	std::vector<std::uint32_t> buckets(num_buckets);
+	std::string strings;
+	std::string symtab;
+	for (std::size_t i = 0; i < symbols.size(); ++i) {
+	    const auto &sym = symbols[i];
+	    std::uint32_t h = codec::fnv1a_32(sym.name);
+	    std::uint32_t b = h & (num_buckets - 1);
+	    while (buckets[b]) {
+		b = (b + 1) & (num_buckets - 1);
+	    }
+	    buckets[b] = i + 1;
+	    put_uint(symtab, h, 4);
+	    put_uint(symtab, strings.size(), 4);
+	    put_uint(symtab, sym.name.size(), 4);
+	    put_uint(symtab, sym.member, 4);
+	    strings += sym.name;
+	}
+	std::string memtab;
+	for (const auto &m : members) {
+	    put_uint(memtab, m.offset, 8);
+	    put_uint(memtab, m.size, 8);
+	    put_uint(memtab, strings.size(), 4);
+	    put_uint(memtab, m.name.size(), 4);
+	    strings += m.name;
+	}
+
+	std::string out(magic, sizeof(magic));
+	put_uint(out, version, 4);
+	put_uint(out, num_buckets, 4);
+	put_uint(out, symbols.size(), 4);
+	put_uint(out, members.size(), 4);
+	put_uint(out, strings.size(), 8);
+	for (std::uint32_t b : buckets) {
+	    put_uint(out, b, 4);
+	}
+	return out + symtab + memtab + strings;
+    }
+
+  private:
+    struct symbol
+    {
+	std::string name;
+	std::uint32_t member;
+    };
+    struct member
+    {
+	std::string name;
+	std::uint64_t offset, size;
+    };
+    std::vector<symbol> symbols;
+    std::vector<member> members;
+    std::unordered_map<std::string, std::uint32_t> known;
+};
+
+/* read-only view of an index, the data must outlive the table */
+class table
+{
+  public:
+    table()
+      : num_buckets(0)
+      , num_symbols(0)
+      , num_members(0)
+    {
+    }
+
+    /* returns false if data is not a valid index */
+    bool
+    open(std::string_view data)
+    {
+	using codec::get_uint;
+
+	*this = table();
+	if (data.size() < header_size || !is_index(data) ||
+	    get_uint(&data[8], 4) != version)
+	{
+	    return false;
+	}
+	std::uint64_t buckets_ = get_uint(&data[12], 4);
+	std::uint64_t symbols_ = get_uint(&data[16], 4);
+	std::uint64_t members_ = get_uint(&data[20], 4);
+	std::uint64_t strings_size = get_uint(&data[24], 8);
+	if (buckets_ == 0 || (buckets_ & (buckets_ - 1)) ||
+	    symbols_ >= buckets_)
+	{
+	    return false;
+	}
+	/* consume the tables one at a time so that no sum can wrap */
+	std::uint64_t rest = data.size() - header_size;
+	if (buckets_ > rest / 4) {
+	    return false;
+	}
+	rest -= 4 * buckets_;
+	if (symbols_ > rest / symbol_size) {
+	    return false;
+	}
+	rest -= symbol_size * symbols_;
+	if (members_ > rest / member_size) {
+	    return false;
+	}
+	rest -= member_size * members_;
+	if (strings_size != rest) {
+	    return false;
+	}
+	buckets = data.data() + header_size;
+	symbols = buckets + 4 * buckets_;
+	members = symbols + symbol_size * symbols_;
+	strings = std::string_view(members + member_size * members_,
+				   strings_size);
+	num_buckets = buckets_;
+	num_symbols = symbols_;
+	num_members = members_;
+	/* each probe of find() must end at an empty bucket */
+	bool has_empty = false;
+	for (std::uint32_t b = 0; b < num_buckets; ++b) {
+	    std::uint64_t i = get_uint(buckets + 4 * b, 4);
+	    if (i > num_symbols) {
+		*this = table();
+		return false;
+	    }
+	    has_empty |= i == 0;
+	}
+	if (!has_empty) {
+	    *this = table();
+	    return false;
+	}
+	for (std::uint32_t i = 0; i < num_symbols; ++i) {
+	    const char *p = symbols + symbol_size * i;
+	    if (get_uint(p + 12, 4) >= num_members || !string_at(p + 4)) {
+		*this = table();
+		return false;
+	    }
+	}
+	for (std::uint32_t i = 0; i < num_members; ++i) {
+	    if (!string_at(members + member_size * i + 16)) {
+		*this = table();
+		return false;
+	    }
+	}
+	return true;
+    }
+
+    bool
+    is_open() const
+    {
+	return num_buckets > 0;
+    }
+
+    /* returns the member which defines name, if any */
+    std::optional<std::uint32_t>
+    find(std::string_view name) const
+    {
+	using codec::get_uint;
+
+	if (!is_open()) {
+	    return std::nullopt;
+	}
+	std::uint32_t h = codec::fnv1a_32(name);
+	std::uint32_t b = h & (num_buckets - 1);
+	for (std::uint32_t step = 0; step < num_buckets; ++step) {
+	    std::uint32_t i = get_uint(buckets + 4 * b, 4);
+	    if (i == 0 || i > num_symbols) {
+		return std::nullopt;
+	    }
+	    const char *p = symbols + symbol_size * (i - 1);
+	    if (get_uint(p, 4) == h && *string_at(p + 4) == name) {
+		return get_uint(p + 12, 4);
+	    }
+	    b = (b + 1) & (num_buckets - 1);
+	}
+	/* not reached as open() requires an empty bucket */
+	return std::nullopt;
+    }
+
+    std::uint32_t
+    size() const
+    {
+	return num_members;
+    }
+
+    std::uint64_t
+    member_offset(std::uint32_t m) const
+    {
+	return codec::get_uint(members + member_size * m, 8);
+    }
+
+    std::uint64_t
+    member_size_of(std::uint32_t m) const
+    {
+	return codec::get_uint(members + member_size * m + 8, 8);
+    }
+
+    std::string_view
+    member_name(std::uint32_t m) const
+    {
+	return *string_at(members + member_size * m + 16);
+    }
+
+  private:
+    /* string given by offset and length at p */
+    std::optional<std::string_view>
+    string_at(const char *p) const
+    {
+	std::uint64_t offset = codec::get_uint(p, 4);
+	std::uint64_t len = codec::get_uint(p + 4, 4);
+	if (offset > strings.size() || len > strings.size() - offset) {
+	    return std::nullopt;
+	}
+	return strings.substr(offset, len);
+    }
+
+    const char *buckets = nullptr;
+    const char *symbols = nullptr;
+    const char *members = nullptr;
+    std::string_view strings;
+    std::uint32_t num_buckets, num_symbols, num_members;
+};
+
+} // namespace arindex
+
+#endif // ARCHIVE_INDEX_HPP
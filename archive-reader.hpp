@@ -24,7 +24,7 @@
 */
 
 /*
-   This header-only C++11 package provides reading access to the
+   This header-only C++17 package provides reading access to the
    so-called common portable archive format. The format is called
    portable as (in contrast to its predecessors) it avoids any
    dependencies to the endianness of the host system by representing
@@ -32,7 +32,7 @@
    it is widely used on Linux, BSD, and Solaris -- but with some minor
    variations.
 
-   This package depends on the C++11 standard, the POSIX standard, and
+   This package depends on the C++17 standard, the POSIX standard, and
    on the presence of <ar.h> which is not included in POSIX but widely
    present on systems that support the common portable archive format.
    (POSIX itself includes the ar utility but does not specify its
@@ -71,10 +71,19 @@
 	 // could not be opened (possibly not an archive)
       }
 
-   Archives can be scanned using an iterator. Special
-   elements like the string table (for long filenames)
-   or the symbol table (maintained by ranlib) will be
-   skipped:
+    * Using an archive in memory (e.g. compiled into the program)
+      which must remain valid as long as the archive is open:
+
+      using namespace ar;
+      archive_reader archive;
+      if (archive.open(data, size)) {
+	 // process archive
+      }
+
+   Archives can be scanned using an iterator which visits
+   the members in their physical order. Special elements
+   like the string table (for long filenames) or the symbol
+   table (maintained by ranlib) will be skipped:
 
       for (auto& member: archive) {
 	 fmt::printf("%6o %3u/%3u %10u %s\n",
@@ -84,8 +93,11 @@
 	    member.name);
       }
 
-   Note that member.name is of type std::string, i.e. you
-   must not use std::printf instead of fmt::print.
+   Note that member.name is of type std::string_view which
+   refers into the mapped archive, i.e. you must not use
+   std::printf instead of fmt::print and the name is valid
+   only as long as the archive remains open. Members are
+   found by name through a hash table.
 
    Individual members of an archive (including the symbol table)
    can be read using archive streams.
@@ -98,6 +110,13 @@
 	 // this member could not be opened
       }
 
+   Alternatively, the contents of a member can be accessed
+   directly within the mapped archive:
+
+      if (auto member = archive.find(member_name)) {
+	 // member->data() points to member->size bytes
+      }
+
    Opening the symbol table:
 
       archive_stream in(archive);
@@ -105,25 +124,41 @@
       if (!in) {
 	 // there is no symbol table
       }
+
+   Alternatively, the entries of a symbol table in the System V / GNU
+   format (a 32-bit big endian count, as many 32-bit big endian offsets
+   of member headers, followed by as many NUL-terminated symbol names)
+   can be visited in their order:
+
+      bool ok = archive.for_each_symbol(
+	 [](const char* symbol, const archive_reader::member& member) {
+	    // ...
+	 });
+      if (!ok) {
+	 // there is no symbol table or it is malformed
+      }
 */
 
 #ifndef ARCHIVE_READER_HPP
 #define ARCHIVE_READER_HPP
 
-#if __cplusplus < 201103L
+#if __cplusplus < 201703L
 #error This file requires compiler and library support for the \
-ISO C++ 2011 standard.
+ISO C++ 2017 standard.
 #else
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <iterator>
 #include <limits>
-#include <map>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 /* POSIX headers */
 #include <fcntl.h>
@@ -140,7 +175,8 @@ namespace internal {
 
 struct archive_header
 {
-    std::string name;
+    /* refers into the header or the string table */
+    std::string_view name;
     bool is_string_table;
     unsigned int date;
     unsigned int uid;
@@ -229,7 +265,7 @@ struct archive_header
 	}
 	is_string_table = hdr->ar_name[0] == '/' && hdr->ar_name[1] == '/';
 	if (is_string_table) {
-	    name = "";
+	    name = std::string_view();
 	    date = uid = gid = mode = 0;
 	    return extract_value(hdr->ar_size, 10, size);
 	} else {
@@ -259,8 +295,7 @@ struct archive_header
 		if (len == 0) {
 		    return false;
 		}
-		name.clear();
-		name.append(string_table + offset, len);
+		name = std::string_view(string_table + offset, len);
 	    } else {
 		std::size_t i = 0;
 		std::size_t blank = 0;
@@ -288,8 +323,7 @@ struct archive_header
 		    /* not properly terminated */
 		    return false;
 		}
-		name.clear();
-		name.append(hdr->ar_name, namelen);
+		name = std::string_view(hdr->ar_name, namelen);
 	    }
 	    return extract_value(hdr->ar_date, 10, date) &&
 		   extract_value(hdr->ar_uid, 10, uid) &&
@@ -315,7 +349,7 @@ class archive_reader
 	friend class archive_stream;
 
       private:
-	member(std::string name, time_t mtime, uid_t uid, gid_t gid,
+	member(std::string_view name, time_t mtime, uid_t uid, gid_t gid,
 	       mode_t mode, size_t size, const char *addr)
 	  : name(name)
 	  , mtime(mtime)
@@ -328,19 +362,26 @@ class archive_reader
 	}
 
       public:
-	std::string name;
+	std::string_view name;
 	time_t mtime;
 	uid_t uid;
 	gid_t gid;
 	mode_t mode;
 	size_t size;
 
+	/* contents of this member within the mapped archive */
+	const char *
+	data() const
+	{
+	    return addr;
+	}
+
       private:
 	const char *addr;
     };
 
   private:
-    using directory = std::map<std::string, member>;
+    using directory = std::vector<member>;
     using directory_it = directory::const_iterator;
 
   public:
@@ -382,7 +423,7 @@ class archive_reader
 	reference
 	operator*() const
 	{
-	    return it->second;
+	    return *it;
 	}
 
       private:
@@ -411,7 +452,7 @@ class archive_reader
     bool
     is_open() const
     {
-	return fd >= 0;
+	return addr != nullptr;
     }
 
     bool
@@ -463,18 +504,38 @@ class archive_reader
 	return true;
     }
 
+    /* nothing is mapped, data is neither copied nor released */
+    bool
+    open(const char *data, std::size_t size)
+    {
+	close();
+	if (size < SARMAG || std::memcmp(data, ARMAG, SARMAG) != 0) {
+	    return false;
+	}
+	addr = data;
+	len = size;
+	if (!scan()) {
+	    close();
+	    return false;
+	}
+	return true;
+    }
+
     void
     close()
     {
-	if (fd >= 0 && len > 0) {
-	    ::munmap(const_cast<char *>(addr), len);
-	    ::close(fd);
-	    fd = -1;
+	if (addr) {
+	    if (fd >= 0) {
+		::munmap(const_cast<char *>(addr), len);
+		::close(fd);
+		fd = -1;
+	    }
 	    addr = nullptr;
 	    len = 0;
 	    symtable = nullptr;
 	    symtable_len = 0;
 	    members.clear();
+	    by_name.clear();
 	}
     }
 
@@ -490,7 +551,86 @@ class archive_reader
 	return members.cend();
     }
 
+    /* returns nullptr if there is no member with the given name */
+    const member *
+    find(std::string_view name) const
+    {
+	auto it = by_name.find(name);
+	return it == by_name.end() ? nullptr : &members[it->second];
+    }
+
+    /* returns nullptr if no member header is found at the given
+       offset from the beginning of the archive */
+    const member *
+    member_at(std::size_t offset) const
+    {
+	/* members are kept in the order of their offsets */
+	auto it = std::lower_bound(members.begin(), members.end(), offset,
+				   [this](const member &m, std::size_t offset) {
+				       return offset_of(m) < offset;
+				   });
+	if (it == members.end() || offset_of(*it) != offset) {
+	    return nullptr;
+	}
+	return &*it;
+    }
+
+    /* offset of the header of m from the beginning of the archive,
+       i.e. member_at(offset_of(m)) == &m */
+    std::size_t
+    offset_of(const member &m) const
+    {
+	return m.addr - addr - sizeof(struct ar_hdr);
+    }
+
+    /* calls f(symbol, member) for each entry of the symbol table;
+       nothing is called and false is returned if there is no
+       symbol table or if it is malformed */
+    template<typename F>
+    bool
+    for_each_symbol(F f) const
+    {
+	if (!symtable || symtable_len < 4) {
+	    return false;
+	}
+	const unsigned char *table =
+	  reinterpret_cast<const unsigned char *>(symtable);
+	std::size_t count = get_uint32(table);
+	if (count > (symtable_len - 4) / 4) {
+	    return false;
+	}
+	const char *names = symtable + 4 + 4 * count;
+	const char *end = symtable + symtable_len;
+	/* check everything before the first call of f */
+	const char *name = names;
+	for (std::size_t i = 0; i < count; ++i) {
+	    if (!member_at(get_uint32(table + 4 + 4 * i))) {
+		return false;
+	    }
+	    auto nul = static_cast<const char *>(
+	      std::memchr(name, 0, end - name));
+	    if (!nul) {
+		return false;
+	    }
+	    name = nul + 1;
+	}
+	name = names;
+	for (std::size_t i = 0; i < count; ++i) {
+	    f(name, *member_at(get_uint32(table + 4 + 4 * i)));
+	    name += std::strlen(name) + 1;
+	}
+	return true;
+    }
+
   private:
+    static std::size_t
+    get_uint32(const unsigned char *p)
+    {
+	/* big endian, independent of the host */
+	return std::size_t(p[0]) << 24 | std::size_t(p[1]) << 16 |
+	       std::size_t(p[2]) << 8 | std::size_t(p[3]);
+    }
+
     bool
     scan()
     {
@@ -518,19 +658,16 @@ class archive_reader
 		symtable = begin;
 		symtable_len = header.size;
 	    } else {
-		auto res = members.insert({ header.name,
-					    {
-					      header.name,
-					      header.date,
-					      header.uid,
-					      header.gid,
-					      static_cast<mode_t>(header.mode),
-					      header.size,
-					      begin,
-					    } });
-		if (!res.second) {
+		if (!by_name.emplace(header.name, members.size()).second) {
 		    return false;
 		}
+		members.push_back({ header.name,
+				    header.date,
+				    header.uid,
+				    header.gid,
+				    static_cast<mode_t>(header.mode),
+				    header.size,
+				    begin });
 	    }
 	    cp += sizeof(struct ar_hdr) + header.size;
 	    if (header.size % 2) {
@@ -547,8 +684,10 @@ class archive_reader
     /* symbol table, if any */
     const char *symtable;
     std::size_t symtable_len;
-    /* member directory */
+    /* member directory in physical order */
     directory members;
+    /* indices into members by name */
+    std::unordered_map<std::string_view, std::size_t> by_name;
 };
 
 class archive_stream;
@@ -587,15 +726,15 @@ class archive_stream : public std::basic_istream<char>
     }
 
     void
-    open(std::string name)
+    open(std::string_view name)
     {
-	auto it = reader.members.find(name);
-	if (it == reader.members.end()) {
+	auto m = reader.find(name);
+	if (!m) {
 	    setstate(failbit);
 	    return;
 	}
 	clear();
-	buf.set(it->second.addr, it->second.size);
+	buf.set(m->addr, m->size);
     }
 
     void
@@ -622,5 +761,5 @@ class archive_stream : public std::basic_istream<char>
 
 } // namespace ar
 
-#endif // of #if __cplusplus < 201103L #else ...
+#endif // of #if __cplusplus < 201703L #else ...
 #endif // ARCHIVE_READER_HPP
@@ -0,0 +1,101 @@
+/*
+   Building blocks shared by the binary formats (objects, images and
+   archive indexes): unsigned integers of 1 to 8 bytes in little endian
+   order, FNV-1a hashes and a word-wise checksum.
+
+      std::string out;
+      codec::put_uint(out, value, 4);	// or to an io::output_buffer
+      auto value = codec::get_uint(out.data(), 4);
+      auto h = codec::fnv1a_64(name);
+      auto sum = codec::checksum_64(contents);
+*/
+
+#ifndef BINARY_CODEC_HPP
+#define BINARY_CODEC_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace codec {
+
+namespace internal {
+
+inline void
+put_byte(std::string &out, char byte)
+{
+    out.push_back(byte);
+}
+
+/* output streams with put(char) like io::output_buffer */
+template<typename Out>
+inline void
+put_byte(Out &out, char byte)
+{
+    out.put(byte);
+}
+
+} // namespace internal
+
+template<typename Out>
+inline void
+put_uint(Out &out, std::uint64_t value, int size)
+{
+    for (int i = 0; i < size; ++i) {
+	internal::put_byte(out, static_cast<char>(value >> 8 * i));
+    }
+}
+
+inline std::uint64_t
+get_uint(const char *p, int size)
+{
+    std::uint64_t value = 0;
+    for (int i = size; i-- > 0;) {
+	value = value << 8 | static_cast<unsigned char>(p[i]);
+    }
+    return value;
+}
+
+inline std::uint32_t
+fnv1a_32(std::string_view s)
+{
+    std::uint32_t h = 0x811c9dc5u;
+    for (unsigned char ch : s) {
+	h = (h ^ ch) * 0x01000193u;
+    }
+    return h;
+}
+
+inline std::uint64_t
+fnv1a_64(std::string_view s)
+{
+    std::uint64_t h = 0xcbf29ce484222325u;
+    for (unsigned char ch : s) {
+	h = (h ^ ch) * 0x100000001b3u;
+    }
+    return h;
+}
+
+/* checksum of larger contents which consumes 8 bytes per step; words
+   are read in host order, so it is meant to detect changes only */
+inline std::uint64_t
+checksum_64(std::string_view s)
+{
+    std::uint64_t h = 0xcbf29ce484222325u ^ s.size();
+    std::size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+	std::uint64_t word;
+	std::memcpy(&word, s.data() + i, 8);
+	h = (h ^ word) * 0x9e3779b97f4a7c15u;
+	h ^= h >> 29;
+    }
+    for (; i < s.size(); ++i) {
+	h = (h ^ static_cast<unsigned char>(s[i])) * 0x100000001b3u;
+    }
+    return h;
+}
+
+} // namespace codec
+
+#endif // BINARY_CODEC_HPP
@@ -0,0 +1,169 @@
+/*
+   Bulk conversion of hexadecimal digits into bytes:
+
+      std::size_t bad = hex::decode(digits, numBytes, bytes);
+
+   converts the 2 * numBytes digits at digits (without any separators)
+   into numBytes bytes at bytes. Both upper and lower case digits are
+   accepted. The return value is the number of bytes that were not given
+   by two valid digits; these bytes are stored as if the invalid digits
+   were 0.
+
+   On x86-64, blocks of 32 digits are converted with AVX2 if the CPU
+   supports it (checked once at runtime) and blocks of 16 digits with
+   SSE2. Remaining digits, and all digits on other platforms, are
+   converted by a table lookup.
+*/
+
+#ifndef HEX_DECODE_HPP
+#define HEX_DECODE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HEX_DECODE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace hex {
+
+namespace internal {
+
+constexpr std::array<std::int8_t, 256>
+make_digit_table()
+{
+    std::array<std::int8_t, 256> table{};
+    for (int ch = 0; ch < 256; ++ch) {
+	if (ch >= '0' && ch <= '9') {
+	    table[ch] = ch - '0';
+	} else if (ch >= 'A' && ch <= 'F') {
+	    table[ch] = ch - 'A' + 10;
+	} else if (ch >= 'a' && ch <= 'f') {
+	    table[ch] = ch - 'a' + 10;
+	} else {
+	    table[ch] = -1;
+	}
+    }
+    return table;
+}
+
+inline constexpr std::array<std::int8_t, 256> digit_table = make_digit_table();
+
+inline std::size_t
+decode_scalar(const char *digits, std::size_t numBytes, unsigned char *bytes)
+{
+    std::size_t bad = 0;
+    for (std::size_t i = 0; i < numBytes; ++i) {
+	int hi = digit_table[static_cast<unsigned char>(digits[2 * i])];
+	int lo = digit_table[static_cast<unsigned char>(digits[2 * i + 1])];
+	if ((hi | lo) < 0) {
+	    ++bad;
+	    hi = hi < 0 ? 0 : hi;
+	    lo = lo < 0 ? 0 : lo;
+	}
+	bytes[i] = hi << 4 | lo;
+    }
+    return bad;
+}
+
+#ifdef HEX_DECODE_X86
+
+/* 16 digits -> 8 bytes, returns false if any digit is invalid */
+inline bool
+decode_sse2(const char *digits, unsigned char *bytes)
+{
+    __m128i ch = _mm_loadu_si128(reinterpret_cast<const __m128i *>(digits));
+    __m128i lc = _mm_or_si128(ch, _mm_set1_epi8(0x20));
+
+    __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(ch, _mm_set1_epi8('0' - 1)),
+				    _mm_cmplt_epi8(ch, _mm_set1_epi8('9' + 1)));
+    __m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+				    _mm_cmplt_epi8(lc, _mm_set1_epi8('f' + 1)));
+    if (_mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha)) != 0xFFFF) {
+	return false;
+    }
+    __m128i value = _mm_or_si128(
+      _mm_and_si128(isDigit, _mm_sub_epi8(ch, _mm_set1_epi8('0'))),
+      _mm_and_si128(isAlpha, _mm_sub_epi8(lc, _mm_set1_epi8('a' - 10))));
+
+    /* each 16-bit lane holds the high nibble in its low byte */
+    __m128i hi = _mm_and_si128(value, _mm_set1_epi16(0x00FF));
+    __m128i lo = _mm_srli_epi16(value, 8);
+    __m128i pairs = _mm_or_si128(_mm_slli_epi16(hi, 4), lo);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(bytes),
+		     _mm_packus_epi16(pairs, pairs));
+    return true;
+}
+
+/* 32 digits -> 16 bytes, returns false if any digit is invalid */
+__attribute__((target("avx2"))) inline bool
+decode_avx2(const char *digits, unsigned char *bytes)
+{
+    __m256i ch =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(digits));
+    __m256i lc = _mm256_or_si256(ch, _mm256_set1_epi8(0x20));
+
+    __m256i isDigit =
+      _mm256_andnot_si256(_mm256_cmpgt_epi8(ch, _mm256_set1_epi8('9')),
+			  _mm256_cmpgt_epi8(ch, _mm256_set1_epi8('0' - 1)));
+    __m256i isAlpha =
+      _mm256_andnot_si256(_mm256_cmpgt_epi8(lc, _mm256_set1_epi8('f')),
+			  _mm256_cmpgt_epi8(lc, _mm256_set1_epi8('a' - 1)));
+    if (~_mm256_movemask_epi8(_mm256_or_si256(isDigit, isAlpha))) {
+	return false;
+    }
+    __m256i value = _mm256_or_si256(
+      _mm256_and_si256(isDigit, _mm256_sub_epi8(ch, _mm256_set1_epi8('0'))),
+      _mm256_and_si256(isAlpha,
+		       _mm256_sub_epi8(lc, _mm256_set1_epi8('a' - 10))));
+
+    __m256i hi = _mm256_and_si256(value, _mm256_set1_epi16(0x00FF));
+    __m256i lo = _mm256_srli_epi16(value, 8);
+    __m256i pairs = _mm256_or_si256(_mm256_slli_epi16(hi, 4), lo);
+    /* packus works per 128-bit lane, gather the two low quadwords */
+    __m256i packed = _mm256_packus_epi16(pairs, pairs);
+    packed = _mm256_permute4x64_epi64(packed, 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(bytes),
+		     _mm256_castsi256_si128(packed));
+    return true;
+}
+
+inline bool
+have_avx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif // HEX_DECODE_X86
+
+} // namespace internal
+
+inline std::size_t
+decode(const char *digits, std::size_t numBytes, unsigned char *bytes)
+{
+    std::size_t bad = 0;
+    std::size_t i = 0;
+#ifdef HEX_DECODE_X86
+    if (internal::have_avx2()) {
+	for (; i + 16 <= numBytes; i += 16) {
+	    if (!internal::decode_avx2(digits + 2 * i, bytes + i)) {
+		bad += internal::decode_scalar(digits + 2 * i, 16, bytes + i);
+	    }
+	}
+    }
+    for (; i + 8 <= numBytes; i += 8) {
+	if (!internal::decode_sse2(digits + 2 * i, bytes + i)) {
+	    bad += internal::decode_scalar(digits + 2 * i, 8, bytes + i);
+	}
+    }
+#endif
+    return bad + internal::decode_scalar(digits + 2 * i, numBytes - i,
+					 bytes + i);
+}
+
+} // namespace hex
+
+#endif // HEX_DECODE_HPP
@@ -1,13 +1,99 @@
+/*
+   Generates call_start.hpp which is included by ulmld. The startup code
+   of call_start.o is parsed at build time and emitted as constant tables
+   of segment bytes, comments, symbols and fixups which are passed to
+   ObjectFile::addObject as ParsedObject, i.e. ulmld does not parse any
+   text for it.
+*/
+
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include "parsed-object.hpp"
 
 const char pathToUlm[] = "path-to-ulm";
 const char objFile[] = "call_start.o";
 const char outFile[] = "call_start.hpp";
 
+std::string
+quote(std::string_view s)
+{
+    std::ostringstream os;
+    os << '"';
+    for (unsigned char ch : s) {
+	if (ch == '"' || ch == '\\') {
+	    os << '\\' << ch;
+	} else if (ch < ' ' || ch >= 0x7F) {
+	    os << '\\' << std::oct << std::setw(3) << std::setfill('0')
+	       << unsigned(ch) << std::dec;
+	} else {
+	    os << ch;
+	}
+    }
+    os << '"';
+    return os.str();
+}
+
+const char *
+fixKindName(FixKind kind)
+{
+    switch (kind) {
+	case FixKind::Absolute:
+	    return "FixKind::Absolute";
+	case FixKind::Relative:
+	    return "FixKind::Relative";
+	case FixKind::W0:
+	    return "FixKind::W0";
+	case FixKind::W1:
+	    return "FixKind::W1";
+	case FixKind::W2:
+	    return "FixKind::W2";
+	case FixKind::W3:
+	    return "FixKind::W3";
+    }
+    return "FixKind::Absolute";
+}
+
+void
+writeSection(std::ostream &out, const ParsedObject::Section &section,
+	     const std::string &name, const std::string &var)
+{
+    if (!section.present) {
+	return;
+    }
+    out << "\tobject." << var << ".present = true;\n"
+	<< "\tobject." << var << ".alignment = " << section.alignment
+	<< ";\n"
+	<< "\tobject." << var << ".numHeaders = " << section.numHeaders
+	<< ";\n";
+    if (section.size()) {
+	out << "\tstatic constexpr unsigned char " << name << "[] = {";
+	for (std::size_t i = 0; i < section.size(); ++i) {
+	    out << (i % 8 ? " " : "\n\t    ") << "0x" << std::hex
+		<< std::setw(2) << std::setfill('0')
+		<< unsigned(section.data()[i]) << std::dec << ",";
+	}
+	out << "\n\t};\n"
+	    << "\tobject." << var << ".mapped = " << name << ";\n"
+	    << "\tobject." << var << ".mappedSize = sizeof(" << name
+	    << ");\n";
+    }
+    if (!section.annotations.empty()) {
+	out << "\tstatic constexpr std::pair<std::uint64_t, "
+	    << "std::string_view>\n"
+	    << "\t  " << name << "Annotations[] = {\n";
+	for (auto &[size, comment] : section.annotations) {
+	    out << "\t    { " << size << ", " << quote(comment) << " },\n";
+	}
+	out << "\t};\n"
+	    << "\tobject." << var << ".annotations.assign(\n"
+	    << "\t  std::begin(" << name << "Annotations),\n"
+	    << "\t  std::end(" << name << "Annotations));\n";
+    }
+}
+
 int
 main(void)
 {
@@ -22,6 +108,11 @@ main(void)
 	    std::cerr << "can not open '" << objFile << "'" << std::endl;
 	    return 1;
 	}
+	std::string text{ std::istreambuf_iterator<char>(in),
+			  std::istreambuf_iterator<char>() };
+	ParsedObject object;
+	object.read(text, objFile);
+
 	std::ofstream out(outFile);
 	std::string line;
 
@@ -35,15 +126,46 @@ main(void)
 	out << std::setfill(' ') << std::setw(4) << ' '
 	    << "std::string ulm = \"" << line << "/ulm\";" << std::endl;
 
-	out << std::setfill(' ') << std::setw(4) << ' '
-	    << "std::stringstream ss;" << std::endl;
-	while (std::getline(in, line)) {
-	    out << std::setfill(' ') << std::setw(4) << ' ' << "ss << \""
-		<< line << "\" << std::endl;" << std::endl;
+	out << "    {\n"
+	    << "\tParsedObject object;\n"
+	    << "\tobject.source = \"generated by ulmld\";\n"
+	    << "\tobject.numCorrupted = " << object.numCorrupted << ";\n";
+	writeSection(out, object.sections[0], "callStartText",
+		     "sections[0]");
+	writeSection(out, object.sections[1], "callStartData",
+		     "sections[1]");
+	if (object.hasBss) {
+	    out << "\tobject.hasBss = true;\n"
+		<< "\tobject.bssAlignment = " << object.bssAlignment << ";\n"
+		<< "\tobject.bssSize = " << object.bssSize << ";\n";
 	}
-	out << std::setfill(' ') << std::setw(4) << ' '
-	    << "objectFile.readSegments(ss, \"generated by ulmld\");"
-	    << std::endl;
+	if (!object.symbols.empty()) {
+	    out << "\tstatic constexpr ParsedObject::Symbol "
+		<< "callStartSymbols[] = {\n";
+	    for (auto &sym : object.symbols) {
+		out << "\t    { '" << sym.kind << "', " << quote(sym.ident)
+		    << ", 0x" << std::hex << sym.value << std::dec << " },\n";
+	    }
+	    out << "\t};\n"
+		<< "\tobject.symbols.assign(std::begin(callStartSymbols),\n"
+		<< "\t  std::end(callStartSymbols));\n";
+	}
+	if (!object.fixups.empty()) {
+	    out << "\tstatic constexpr ParsedObject::Fixup "
+		<< "callStartFixups[] = {\n";
+	    for (auto &fix : object.fixups) {
+		out << "\t    { " << quote(fix.ident) << ", 0x" << std::hex
+		    << fix.addr << std::dec << ", " << fix.displace << ", "
+		    << unsigned(fix.seg) << ", " << fixKindName(fix.kind)
+		    << ", " << unsigned(fix.offset) << ", "
+		    << unsigned(fix.numBytes) << " },\n";
+	    }
+	    out << "\t};\n"
+		<< "\tobject.fixups.assign(std::begin(callStartFixups),\n"
+		<< "\t  std::end(callStartFixups));\n";
+	}
+	out << "\tobjectFile.addObject(object);\n"
+	    << "    }\n";
 
     } catch (std::exception &e) {
 	std::cerr << "execution aborted" << std::endl << e.what() << std::endl;
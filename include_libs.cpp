@@ -0,0 +1,88 @@
+/*
+   Generates embedded_libs.hpp which is included by ulmld and provides
+   the given archives as string literals, e.g.
+
+      ./include_libs embedded_libs.hpp path/libc.a path/libcrt.a
+
+   makes -lc and -lcrt available without accessing the file system.
+   The archives are expected to carry an index already.
+*/
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include "archive-reader.hpp"
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 2) {
+	std::cerr << "usage: " << argv[0] << " outfile [archive...]"
+		  << std::endl;
+	return 1;
+    }
+    std::ofstream out(argv[1]);
+    out << "// generated by include_libs, see EMBED_LIBS in the Makefile\n";
+    int numLibs = argc - 2;
+    for (int i = 0; i < numLibs; ++i) {
+	const char *path = argv[i + 2];
+	std::ifstream in(path, std::ios::binary);
+	if (in.fail()) {
+	    std::cerr << "can not open '" << path << "'" << std::endl;
+	    return 1;
+	}
+	std::string data{ std::istreambuf_iterator<char>(in),
+			  std::istreambuf_iterator<char>() };
+	ar::archive_reader archive;
+	if (!archive.open(data.data(), data.size())) {
+	    std::cerr << "'" << path << "' is not an archive" << std::endl;
+	    return 1;
+	}
+
+	/* printable characters are kept, all others are given as octal
+	   escapes with three digits such that no digit can follow */
+	out << "static constexpr char embeddedLib" << i << "[] =";
+	std::size_t column = 0;
+	for (unsigned char ch : data) {
+	    if (column == 0) {
+		out << "\n    \"";
+		column = 5;
+	    }
+	    if (ch == '"' || ch == '\\') {
+		out << '\\' << ch;
+		column += 2;
+	    } else if (ch >= ' ' && ch < 0x7F) {
+		out << ch;
+		++column;
+	    } else {
+		out << '\\' << std::oct << std::setw(3) << std::setfill('0')
+		    << unsigned(ch) << std::dec;
+		column += 4;
+	    }
+	    if (column >= 72) {
+		out << '"';
+		column = 0;
+	    }
+	}
+	if (column > 0) {
+	    out << '"';
+	} else if (data.empty()) {
+	    out << " \"\"";
+	}
+	out << ";\n";
+    }
+
+    out << "static constexpr std::array<EmbeddedLibrary, " << numLibs
+	<< "> embeddedLibraries = { {\n";
+    for (int i = 0; i < numLibs; ++i) {
+	std::string name = argv[i + 2];
+	if (auto slash = name.rfind('/'); slash != std::string::npos) {
+	    name.erase(0, slash + 1);
+	}
+	out << "    { \"" << name << "\", std::string_view(embeddedLib" << i
+	    << ", sizeof(embeddedLib" << i << ") - 1) },\n";
+    }
+    out << "} };\n";
+}
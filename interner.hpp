@@ -0,0 +1,155 @@
+/*
+   Interning of strings like symbol names into compact integer ids:
+
+      intern::interner symbols;
+      auto id = symbols.intern(name);	// id of name, added if new
+      auto id2 = symbols.find(name);	// intern::none if not known
+      std::string_view s = symbols.name(id);
+
+   Ids are assigned consecutively from 0 on in the order in which strings
+   are interned, so they can be used as indices into plain vectors. The
+   characters are copied once into an arena (string_pool) and a lookup
+   takes one hash computation and, usually, one probe of an open
+   addressing hash table.
+*/
+
+#ifndef INTERNER_HPP
+#define INTERNER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "binary-codec.hpp"
+
+namespace intern {
+
+using id_type = std::uint32_t;
+constexpr id_type none = ~id_type(0);
+
+/* strings added to a pool stay at their place as long as the pool lives */
+class string_pool
+{
+  public:
+    string_pool()
+      : used(0)
+      , capacity(0)
+    {
+    }
+
+    std::string_view
+    add(std::string_view s)
+    {
+	if (s.size() > capacity - used) {
+	    capacity = s.size() > block_size ? s.size() : block_size;
+	    blocks.push_back(std::make_unique<char[]>(capacity));
+	    used = 0;
+	}
+	char *p = blocks.back().get() + used;
+	if (s.size()) {
+	    std::memcpy(p, s.data(), s.size());
+	}
+	used += s.size();
+	return std::string_view(p, s.size());
+    }
+
+  private:
+    static constexpr std::size_t block_size = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::size_t used, capacity;
+};
+
+class interner
+{
+  public:
+    interner()
+      : slots(initial_size)
+    {
+    }
+
+    id_type
+    intern(std::string_view s)
+    {
+	std::uint64_t h = codec::fnv1a_64(s);
+	std::size_t i = probe(s, h);
+	if (slots[i].id != none) {
+	    return slots[i].id;
+	}
+	id_type id = static_cast<id_type>(names.size());
+	names.push_back(pool.add(s));
+	slots[i] = { h, id };
+	if (2 * names.size() > slots.size()) {
+	    grow();
+	}
+	return id;
+    }
+
+    id_type
+    find(std::string_view s) const
+    {
+	return slots[probe(s, codec::fnv1a_64(s))].id;
+    }
+
+    std::string_view
+    name(id_type id) const
+    {
+	return names[id];
+    }
+
+    std::size_t
+    size() const
+    {
+	return names.size();
+    }
+
+  private:
+    struct slot
+    {
+	std::uint64_t hash = 0;
+	id_type id = none;
+    };
+
+    static constexpr std::size_t initial_size = 1024; // power of 2
+
+    /* returns the slot of s or the empty slot where it belongs */
+    std::size_t
+    probe(std::string_view s, std::uint64_t h) const
+    {
+	std::size_t mask = slots.size() - 1;
+	for (std::size_t i = h & mask;; i = (i + 1) & mask) {
+	    const slot &sl = slots[i];
+	    if (sl.id == none || (sl.hash == h && names[sl.id] == s)) {
+		return i;
+	    }
+	}
+    }
+
+    void
+    grow()
+    {
+	std::vector<slot> old(2 * slots.size());
+	old.swap(slots);
+	std::size_t mask = slots.size() - 1;
+	for (const slot &sl : old) {
+	    if (sl.id == none) {
+		continue;
+	    }
+	    std::size_t i = sl.hash & mask;
+	    while (slots[i].id != none) {
+		i = (i + 1) & mask;
+	    }
+	    slots[i] = sl;
+	}
+    }
+
+    std::vector<slot> slots;
+    std::vector<std::string_view> names;
+    string_pool pool;
+};
+
+} // namespace intern
+
+#endif // INTERNER_HPP
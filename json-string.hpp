@@ -0,0 +1,40 @@
+/*
+   Writes a string as JSON string literal, i.e. in double quotes with
+   quotes, backslashes and control characters escaped:
+
+      json::put_string(out, filename);
+
+   Other bytes are copied as they are, such that UTF-8 is kept.
+*/
+
+#ifndef JSON_STRING_HPP
+#define JSON_STRING_HPP
+
+#include <iomanip>
+#include <ostream>
+#include <string_view>
+
+namespace json {
+
+inline void
+put_string(std::ostream &out, std::string_view s)
+{
+    out << '"';
+    for (unsigned char ch : s) {
+	if (ch == '"' || ch == '\\') {
+	    out << '\\' << ch;
+	} else if (ch < ' ') {
+	    auto fill = out.fill('0');
+	    out << "\\u" << std::hex << std::setw(4) << unsigned(ch)
+		<< std::dec;
+	    out.fill(fill);
+	} else {
+	    out << ch;
+	}
+    }
+    out << '"';
+}
+
+} // namespace json
+
+#endif // JSON_STRING_HPP
@@ -0,0 +1,186 @@
+/*
+   Read-only access to the contents of a file, through mmap for regular
+   files:
+
+      io::mapped_file file;
+      if (file.open(filename)) {
+	 std::string_view text = file.contents();
+	 // process text
+      } else {
+	 // could not be opened
+      }
+
+   The contents stay valid as long as the mapped_file lives. Other files
+   like pipes, FIFOs or /dev/fd/N of a process substitution cannot be
+   mapped and are read into a buffer owned by the mapped_file instead.
+   Empty files can be opened and have empty contents.
+*/
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/* POSIX headers */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace io {
+
+class mapped_file
+{
+  public:
+    mapped_file()
+      : opened(false)
+      , addr(nullptr)
+      , len(0)
+    {
+    }
+
+    explicit mapped_file(const char *filename)
+      : mapped_file()
+    {
+	open(filename);
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    mapped_file(mapped_file &&other)
+      : opened(std::exchange(other.opened, false))
+      , addr(std::exchange(other.addr, nullptr))
+      , len(std::exchange(other.len, 0))
+      , buffer(std::move(other.buffer))
+    {
+	adopt_buffer(other);
+    }
+
+    mapped_file &
+    operator=(mapped_file &&other)
+    {
+	if (this != &other) {
+	    close();
+	    opened = std::exchange(other.opened, false);
+	    addr = std::exchange(other.addr, nullptr);
+	    len = std::exchange(other.len, 0);
+	    buffer = std::move(other.buffer);
+	    adopt_buffer(other);
+	}
+	return *this;
+    }
+
+    ~mapped_file()
+    {
+	close();
+    }
+
+    bool
+    is_open() const
+    {
+	return opened;
+    }
+
+    bool
+    open(const char *filename)
+    {
+	close();
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0) {
+	    return false;
+	}
+	struct ::stat statbuf;
+	if (::fstat(fd, &statbuf) < 0) {
+	    ::close(fd);
+	    return false;
+	}
+	if (!S_ISREG(statbuf.st_mode)) {
+	    bool ok = read_all(fd);
+	    ::close(fd);
+	    return ok;
+	}
+	std::size_t size = static_cast<std::size_t>(statbuf.st_size);
+	if (size > 0) {
+	    void *p = ::mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	    if (p == MAP_FAILED) {
+		::close(fd);
+		return false;
+	    }
+	    addr = static_cast<const char *>(p);
+	    len = size;
+	}
+	/* the mapping does not depend on the file descriptor */
+	::close(fd);
+	opened = true;
+	return true;
+    }
+
+    void
+    close()
+    {
+	if (len > 0 && buffer.empty()) {
+	    ::munmap(const_cast<char *>(addr), len);
+	}
+	opened = false;
+	addr = nullptr;
+	len = 0;
+	buffer.clear();
+	buffer.shrink_to_fit();
+    }
+
+    std::string_view
+    contents() const
+    {
+	return std::string_view(addr, len);
+    }
+
+  private:
+    bool
+    read_all(int fd)
+    {
+	char chunk[65536];
+	for (;;) {
+	    ::ssize_t nbytes = ::read(fd, chunk, sizeof(chunk));
+	    if (nbytes < 0 && errno == EINTR) {
+		continue;
+	    }
+	    if (nbytes < 0) {
+		buffer.clear();
+		return false;
+	    }
+	    if (nbytes == 0) {
+		break;
+	    }
+	    buffer.append(chunk, nbytes);
+	}
+	addr = buffer.data();
+	len = buffer.size();
+	opened = true;
+	return true;
+    }
+
+    /* the buffer was moved from other, addr must follow it */
+    void
+    adopt_buffer(mapped_file &other)
+    {
+	other.buffer.clear();
+	if (!buffer.empty()) {
+	    addr = buffer.data();
+	}
+    }
+
+    bool opened;
+    const char *addr;
+    std::size_t len;
+    /* contents of a file that could not be mapped, empty otherwise */
+    std::string buffer;
+};
+
+} // namespace io
+
+#endif // MAPPED_FILE_HPP
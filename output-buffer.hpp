@@ -0,0 +1,196 @@
+/*
+   Buffered output of text to a file descriptor without iostreams:
+
+      io::output_buffer out(fd);
+      out.put("0x");
+      out.put_hex(addr, 16);		// zero-padded, upper case digits
+      out.put(": ");
+      out.put_hex_byte(byte);		// always two digits
+      out.put('\n');
+      if (!out.flush()) {
+	 // write error
+      }
+
+   Text is collected in a large buffer which is passed to write(2) when
+   it is full and on flush. Bytes are converted into hex digits by a
+   table lookup. Nothing is flushed implicitly on destruction; after a
+   write error further output is discarded and flush returns false.
+*/
+
+#ifndef OUTPUT_BUFFER_HPP
+#define OUTPUT_BUFFER_HPP
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+/* POSIX headers */
+#include <unistd.h>
+
+namespace io {
+
+namespace internal {
+
+constexpr std::array<char, 512>
+make_hex_byte_table()
+{
+    constexpr char digits[] = "0123456789ABCDEF";
+    std::array<char, 512> table{};
+    for (int byte = 0; byte < 256; ++byte) {
+	table[2 * byte] = digits[byte >> 4];
+	table[2 * byte + 1] = digits[byte & 0xF];
+    }
+    return table;
+}
+
+inline constexpr std::array<char, 512> hex_byte_table = make_hex_byte_table();
+
+} // namespace internal
+
+class output_buffer
+{
+  public:
+    explicit output_buffer(int fd, std::size_t capacity = 1 << 20)
+      : fd(fd)
+      , ok(true)
+      , buf(new char[capacity]) // not zero-filled
+      , used(0)
+      , capacity(capacity)
+      , written(0)
+    {
+    }
+
+    output_buffer(const output_buffer &) = delete;
+    output_buffer &operator=(const output_buffer &) = delete;
+
+    void
+    put(char ch)
+    {
+	reserve(1);
+	buf[used++] = ch;
+    }
+
+    void
+    put(std::string_view s)
+    {
+	if (s.size() > capacity) {
+	    flush();
+	    write_all(s.data(), s.size());
+	    return;
+	}
+	reserve(s.size());
+	std::memcpy(buf.get() + used, s.data(), s.size());
+	used += s.size();
+    }
+
+    void
+    put_spaces(std::size_t n)
+    {
+	put_fill(' ', n);
+    }
+
+    void
+    put_fill(char ch, std::size_t n)
+    {
+	while (n > 0) {
+	    std::size_t len = n < capacity ? n : capacity;
+	    reserve(len);
+	    std::memset(buf.get() + used, ch, len);
+	    used += len;
+	    n -= len;
+	}
+    }
+
+    void
+    put_hex_byte(unsigned char byte)
+    {
+	reserve(2);
+	buf[used++] = internal::hex_byte_table[2 * byte];
+	buf[used++] = internal::hex_byte_table[2 * byte + 1];
+    }
+
+    /* upper case digits, zero-padded to at least width digits */
+    void
+    put_hex(std::uint64_t value, int width = 1)
+    {
+	char digits[16];
+	int len = 0;
+	do {
+	    digits[sizeof(digits) - ++len] = "0123456789ABCDEF"[value & 0xF];
+	    value >>= 4;
+	} while (value);
+	if (width > len) {
+	    put_fill('0', width - len);
+	}
+	put(std::string_view(digits + sizeof(digits) - len, len));
+    }
+
+    void
+    put_dec(std::uint64_t value)
+    {
+	char digits[20];
+	int len = 0;
+	do {
+	    digits[sizeof(digits) - ++len] = '0' + value % 10;
+	    value /= 10;
+	} while (value);
+	put(std::string_view(digits + sizeof(digits) - len, len));
+    }
+
+    /* number of bytes passed successfully to write(2) so far */
+    std::uint64_t
+    bytes_written() const
+    {
+	return written;
+    }
+
+    /* returns false if any write failed so far */
+    bool
+    flush()
+    {
+	write_all(buf.get(), used);
+	used = 0;
+	return ok;
+    }
+
+  private:
+    void
+    reserve(std::size_t len)
+    {
+	if (capacity - used < len) {
+	    flush();
+	}
+    }
+
+    void
+    write_all(const char *data, std::size_t len)
+    {
+	while (ok && len > 0) {
+	    ssize_t nbytes = ::write(fd, data, len);
+	    if (nbytes < 0) {
+		if (errno == EINTR) {
+		    continue;
+		}
+		ok = false;
+		break;
+	    }
+	    data += nbytes;
+	    len -= nbytes;
+	    written += nbytes;
+	}
+    }
+
+    int fd;
+    bool ok;
+    std::unique_ptr<char[]> buf;
+    std::size_t used, capacity;
+    std::uint64_t written;
+};
+
+} // namespace io
+
+#endif // OUTPUT_BUFFER_HPP
@@ -0,0 +1,59 @@
+/*
+   Fork-join parallelism for independent work items:
+
+      par::parallel_for(n, num_threads, [&](std::size_t i) {
+	 // process item i
+      });
+
+   calls the given function for all i in [0, n). The calling thread and
+   up to num_threads - 1 additional worker threads fetch the next index
+   from a shared counter until all items are done, so items of varying
+   cost are balanced automatically. The function must not throw;
+   exceptions are to be caught within and passed on, e.g. as
+   std::exception_ptr, to the caller which receives the results in
+   index order.
+*/
+
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace par {
+
+inline unsigned
+default_concurrency()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+template<typename Function>
+void
+parallel_for(std::size_t n, unsigned num_threads, Function f)
+{
+    std::atomic<std::size_t> next{ 0 };
+    auto work = [&]() {
+	for (std::size_t i; (i = next.fetch_add(1)) < n;) {
+	    f(i);
+	}
+    };
+
+    std::size_t num_workers = std::min<std::size_t>(num_threads, n);
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < num_workers; ++i) {
+	workers.emplace_back(work);
+    }
+    work();
+    for (auto &worker : workers) {
+	worker.join();
+    }
+}
+
+} // namespace par
+
+#endif // PARALLEL_FOR_HPP
@@ -0,0 +1,695 @@
+/*
+   The object file model shared by ulmld and the object tools: the
+   Exception class, the kinds of fixes and ParsedObject which reads a
+   single object file in the textual or binary relocatable format and
+   writes it in the binary format.
+*/
+
+#ifndef PARSED_OBJECT_HPP
+#define PARSED_OBJECT_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "binary-codec.hpp"
+#include "hex-decode.hpp"
+#include "mapped-file.hpp"
+#include "output-buffer.hpp"
+#include "text-scanner.hpp"
+
+class Exception : public std::exception
+{
+  private:
+    bool showAddress;
+    std::uint64_t address;
+    std::string msg;
+    std::shared_ptr<Exception> nested;
+    mutable std::string msgbuf; // temporarily used by what()
+  public:
+    Exception()
+      : showAddress(false)
+      , address(0)
+    {
+    }
+
+    Exception(std::uint64_t address, std::string msg)
+      : showAddress(true)
+      , address(address)
+      , msg(msg)
+    {
+    }
+
+    Exception(std::uint64_t address, std::string msg, const Exception &nested)
+      : showAddress(true)
+      , address(address)
+      , msg(msg)
+      , nested(std::make_shared<Exception>(nested))
+    {
+    }
+
+    Exception(std::string msg)
+      : showAddress(false)
+      , address(0)
+      , msg(msg)
+    {
+    }
+
+    Exception(std::string msg, const Exception &nested)
+      : showAddress(false)
+      , address(0)
+      , msg(msg)
+      , nested(std::make_shared<Exception>(nested))
+    {
+    }
+
+    virtual ~Exception() throw() {}
+
+    virtual const char *
+    what() const throw()
+    {
+	std::ostringstream os;
+	if (nested) {
+	    os << nested->what() << std::endl;
+	}
+	if (showAddress) {
+	    os << "[0x" << std::hex << std::setfill('0') << std::setw(16)
+	       << address << "] ";
+	}
+	os << msg;
+
+	msgbuf = os.str();
+	return msgbuf.c_str();
+    }
+};
+
+/*
+    Fixes patch the address of a symbol into the text or data segment:
+    as a whole (absolute), as distance in instructions (relative), or one of
+    its 16-bit words (w0 to w3).
+*/
+
+enum class FixKind : std::uint8_t
+{
+    Absolute,
+    Relative,
+    W0,
+    W1,
+    W2,
+    W3,
+};
+
+inline std::optional<FixKind>
+parseFixKind(std::string_view kind)
+{
+    if (kind == "absolute") {
+	return FixKind::Absolute;
+    } else if (kind == "relative") {
+	return FixKind::Relative;
+    } else if (kind.size() == 2 && kind[0] == 'w' && kind[1] >= '0' &&
+	       kind[1] <= '3')
+    {
+	return FixKind(std::uint8_t(FixKind::W0) + (kind[1] - '0'));
+    }
+    return std::nullopt;
+}
+
+/*
+    Contents of a single object file with all addresses relative to the
+    begin of its own segments. Reading an object file into a ParsedObject
+    does not depend on any other input, ObjectFile::addObject merges it
+    into the link.
+
+    Symbols, fixups and comments refer to the text of the object file which
+    must stay alive until the ParsedObject has been added. If it was read
+    from a mapped file, the mapping can be kept in 'mapping'.
+
+    Object files are either textual (#TEXT, #DATA, #BSS, #SYMTAB and
+    #FIXUPS sections) or binary. A binary object carries the same
+    information, little endian, in a form that is used from the mapped
+    file as it is:
+
+	offset	size
+	     0	   8  magic "\177ULMOBJ\0"
+	     8	   4  version
+	    12	   4  flags: 1 text, 2 data, 4 bss present
+	    16	  32  text: alignment, file offset and size of its bytes (8 each),
+		      number of "# from:" headers and of comments (4 each)
+	    48	  32  data: like text
+	    80	  16  bss: alignment, size
+	    96	  16  symbols: file offset, number
+	   112	  16  fixups: file offset, number
+	   128	   8  comments: file offset (those of text before those of data)
+	   136	  16  string table: file offset, size
+	   152	   8  number of corrupted bytes of the textual source
+
+    Strings are given by their offset and length within the string table
+    (4 bytes each). A symbol (24 bytes) consists of its value (8), name,
+    kind (4) and 4 unused bytes. A fixup (32 bytes) consists of its address
+    and displacement (8 each), name, segment, kind (see FixKind), offset and
+    number of bytes (1 each) and 4 unused bytes. A comment (16 bytes)
+    consists of the section size when it was read (8) and its text.
+*/
+
+struct ParsedObject
+{
+    struct Section
+    {
+	Section()
+	  : present(false)
+	  , alignment(0)
+	  , numHeaders(0)
+	{
+	}
+
+	// hexDigits may contain white space between the digits
+	void
+	insertByteString(std::uint64_t addr, std::string_view hexDigits,
+			 std::size_t &numCorrupted)
+	{
+	    // the buffer is reused for all lines to avoid allocations
+	    static thread_local std::string digits;
+	    digits.clear();
+	    for (char ch : hexDigits) {
+		if (!scan::is_space(ch)) {
+		    digits.push_back(ch);
+		}
+	    }
+
+	    std::size_t numBytes = digits.length();
+	    assert(numBytes % 2 == 0);
+	    numBytes /= 2;
+
+	    if (addr + numBytes > bytes.size()) {
+		bytes.resize(addr + numBytes);
+	    }
+	    numCorrupted +=
+	      hex::decode(digits.data(), numBytes, bytes.data() + addr);
+	}
+
+	const unsigned char *
+	data() const
+	{
+	    return mapped ? mapped : bytes.data();
+	}
+
+	std::size_t
+	size() const
+	{
+	    return mapped ? mappedSize : bytes.size();
+	}
+
+	bool present;
+	std::uint64_t alignment; // 0 if not specified
+	std::vector<unsigned char> bytes;
+	// contents of a binary object within its text, used instead of bytes
+	const unsigned char *mapped = nullptr;
+	std::size_t mappedSize = 0;
+	// number of "# from:" headers, one per line read at the section begin
+	std::size_t numHeaders;
+	// comments together with the section size when they were read
+	std::vector<std::pair<std::uint64_t, std::string_view>> annotations;
+    };
+
+    struct Symbol
+    {
+	char kind;
+	std::string_view ident;
+	std::uint64_t value;
+    };
+
+    struct Fixup
+    {
+	std::string_view ident;
+	std::uint64_t addr;
+	std::int64_t displace;
+	std::uint8_t seg; // 0=text, 1=data
+	FixKind kind;
+	std::uint8_t offset, numBytes;
+    };
+
+    ParsedObject()
+      : hasBss(false)
+      , bssAlignment(0)
+      , bssSize(0)
+      , numCorrupted(0)
+      , numLines(0)
+    {
+    }
+
+    static constexpr char binaryMagic[8] = { '\177', 'U', 'L', 'M',
+					     'O', 'B', 'J', '\0' };
+    static constexpr std::uint32_t binaryVersion = 1;
+    static constexpr std::size_t binaryHeaderSize = 160;
+    static constexpr std::size_t symbolSize = 24, fixupSize = 32,
+				 commentSize = 16;
+
+    static bool
+    isBinary(std::string_view text)
+    {
+	return scan::starts_with(text,
+				 std::string_view(binaryMagic, sizeof(binaryMagic)));
+    }
+
+    // alignments must be powers of two, 0 is not an alignment
+    static bool
+    isAlignment(std::uint64_t alignment)
+    {
+	return alignment && !(alignment & (alignment - 1));
+    }
+
+    // comments are not kept if strip is set
+    void
+    read(std::string_view text, const std::string &source_,
+	 bool strip = false)
+    {
+	std::string_view line;
+	std::uint64_t addr, baseAddr = 0;
+	std::size_t seg = -1;
+
+	source = source_;
+	if (isBinary(text)) {
+	    readBinary(text, strip);
+	    return;
+	}
+	if (text.empty() || text[0] != '#') {
+	    std::ostringstream os;
+	    os << "not an object file " << source;
+	    throw Exception(os.str());
+	}
+
+	while (scan::next_line(text, line)) {
+	    ++numLines;
+	    if (scan::starts_with(line, "#TEXT") ||
+		scan::starts_with(line, "#DATA"))
+	    {
+		seg = line[1] == 'T' ? 0 : 1;
+		line.remove_prefix(5);
+		if (sections[seg].present) {
+		    std::ostringstream os;
+		    os << "multiple " << (seg == 0 ? "#TEXT" : "#DATA")
+		       << " sections in " << source;
+		    throw Exception(os.str());
+		}
+		sections[seg].present = true;
+		scan::parse_dec(line, sections[seg].alignment);
+		if (sections[seg].alignment &&
+		    !isAlignment(sections[seg].alignment))
+		{
+		    std::ostringstream os;
+		    os << "invalid alignment " << sections[seg].alignment
+		       << " of " << (seg == 0 ? "#TEXT" : "#DATA") << " in "
+		       << source;
+		    throw Exception(os.str());
+		}
+		continue;
+	    }
+	    if (scan::starts_with(line, "#BSS")) {
+		seg = 2;
+		line.remove_prefix(4);
+		if (hasBss) {
+		    std::ostringstream os;
+		    os << "multiple #BSS sections in " << source;
+		    throw Exception(os.str());
+		}
+		if (!scan::parse_dec(line, bssAlignment) ||
+		    !scan::parse_dec(line, bssSize))
+		{
+		    std::ostringstream os;
+		    os << "expected alignment and size after #BSS in "
+		       << source;
+		    throw Exception(os.str());
+		}
+		if (!isAlignment(bssAlignment)) {
+		    std::ostringstream os;
+		    os << "invalid alignment " << bssAlignment << " of #BSS in "
+		       << source;
+		    throw Exception(os.str());
+		}
+		hasBss = true;
+		continue;
+	    }
+	    if (scan::starts_with(line, "#SYMTAB")) {
+		seg = 3;
+		continue;
+	    }
+	    if (scan::starts_with(line, "#FIXUPS")) {
+		seg = 4;
+		continue;
+	    }
+	    if (scan::starts_with(line, "#") || line.length() == 0) {
+		continue;
+	    }
+	    // reading text or data segement
+	    if (seg == 0 || seg == 1) {
+		Section &section = sections[seg];
+
+		// split off comment (if any)
+		std::string_view comment;
+		if (std::size_t pos = line.find('#');
+		    pos != std::string_view::npos)
+		{
+		    comment = line.substr(pos + 1);
+		    if (scan::starts_with(comment, " ")) {
+			comment.remove_prefix(1);
+		    }
+		    line = line.substr(0, pos);
+		}
+
+		bool atBegin = section.bytes.empty();
+		if (atBegin) {
+		    ++section.numHeaders;
+		}
+
+		// extract address (if any)
+		if (std::size_t pos = line.find(':');
+		    pos != std::string_view::npos)
+		{
+		    std::string_view addrField = line.substr(0, pos);
+		    scan::parse_hex(addrField, addr);
+		    line.remove_prefix(pos + 1);
+
+		    if (atBegin) {
+			baseAddr = addr;
+		    }
+		    addr -= baseAddr;
+		} else {
+		    addr = section.bytes.size();
+		    if (atBegin) {
+			baseAddr = addr;
+		    }
+		}
+
+		if (addr > section.bytes.size()) {
+		    std::ostringstream os;
+		    os << "In segment '" << seg
+		       << "' (0=text, 1=data, "
+			  "2=bss) there is a gap that would require "
+			  "fillin bytes. That's only allowed for "
+			  "alignment";
+		    throw Exception(os.str());
+		}
+		section.insertByteString(addr, line, numCorrupted);
+		if (comment.length() && !strip) {
+		    section.annotations.push_back(
+		      { section.bytes.size(), comment });
+		}
+		continue;
+	    }
+	    // reading symtab
+	    if (seg == 3) {
+		Symbol sym{ 0, {}, 0 };
+
+		scan::skip_space(line);
+		if (line.empty()) {
+		    continue;
+		}
+		sym.kind = line[0];
+		line.remove_prefix(1);
+		sym.ident = scan::next_token(line);
+		scan::parse_hex(line, sym.value);
+		symbols.push_back(sym);
+		continue;
+	    }
+	    // reading fixables
+	    if (seg == 4) {
+		Fixup fix{ {}, 0, 0, 0, FixKind::Absolute, 0, 0 };
+		std::uint64_t offset = 0, numBytes = 0;
+
+		std::string_view segment = scan::next_token(line);
+		scan::parse_hex(line, fix.addr);
+		scan::parse_dec(line, offset);
+		scan::parse_dec(line, numBytes);
+		std::string_view kind = scan::next_token(line);
+		fix.ident = scan::next_token(line);
+
+		if (segment == "text" || segment == "data") {
+		    fix.seg = segment == "text" ? 0 : 1;
+		} else {
+		    std::ostringstream os;
+		    os << "Can't apply a fix in segment " << segment;
+		    throw Exception(os.str());
+		}
+		if (auto k = parseFixKind(kind)) {
+		    fix.kind = *k;
+		} else {
+		    std::ostringstream os;
+		    os << "Can not apply a '" << kind << "' fix.";
+		    throw Exception(os.str());
+		}
+
+		// hack to support ulmas for ulm-generator
+		assert(offset % 8 == 0);
+		assert(numBytes % 4 == 0);
+		offset /= 8;
+		numBytes /= 8;
+		if (offset > 0xFF || numBytes > 8) {
+		    std::ostringstream os;
+		    os << "Can not apply a fix of " << numBytes
+		       << " bytes at offset " << offset;
+		    throw Exception(os.str());
+		}
+		fix.offset = offset;
+		fix.numBytes = numBytes;
+
+		if (std::size_t p = fix.ident.find('+');
+		    p != std::string_view::npos)
+		{
+		    std::string_view d = fix.ident.substr(p);
+		    scan::parse_signed(d, fix.displace);
+		    fix.ident = fix.ident.substr(0, p);
+		} else if (std::size_t p = fix.ident.find('-');
+			   p != std::string_view::npos)
+		{
+		    std::string_view d = fix.ident.substr(p);
+		    scan::parse_signed(d, fix.displace);
+		    fix.ident = fix.ident.substr(0, p);
+		}
+		fixups.push_back(fix);
+		continue;
+	    }
+	}
+    }
+
+    void
+    readBinary(std::string_view text, bool strip)
+    {
+	using codec::get_uint;
+
+	auto corrupt = [this]() {
+	    std::ostringstream os;
+	    os << "corrupt binary object file " << source;
+	    return Exception(os.str());
+	};
+	if (text.size() < binaryHeaderSize ||
+	    get_uint(&text[8], 4) != binaryVersion)
+	{
+	    throw corrupt();
+	}
+	const char *h = text.data();
+	// num elements of the given size at the file offset found at p
+	auto array = [&](const char *p, std::uint64_t num, std::size_t size) {
+	    std::uint64_t offset = get_uint(p, 8);
+	    if (offset > text.size() || num > (text.size() - offset) / size) {
+		throw corrupt();
+	    }
+	    return text.data() + offset;
+	};
+	std::uint64_t stringsSize = get_uint(h + 144, 8);
+	const char *strings = array(h + 136, stringsSize, 1);
+	auto string = [&](const char *p) {
+	    std::uint64_t offset = get_uint(p, 4), len = get_uint(p + 4, 4);
+	    if (offset > stringsSize || len > stringsSize - offset) {
+		throw corrupt();
+	    }
+	    return std::string_view(strings + offset, len);
+	};
+
+	std::uint32_t flags = get_uint(h + 12, 4);
+	const char *comment = array(
+	  h + 128, get_uint(h + 44, 4) + get_uint(h + 76, 4), commentSize);
+	for (std::size_t seg = 0; seg < 2; ++seg) {
+	    const char *p = h + 16 + 32 * seg;
+	    Section &section = sections[seg];
+	    section.present = flags & (1 << seg);
+	    section.alignment = get_uint(p, 8);
+	    if (section.alignment && !isAlignment(section.alignment)) {
+		throw corrupt();
+	    }
+	    section.mappedSize = get_uint(p + 16, 8);
+	    section.mapped = reinterpret_cast<const unsigned char *>(
+	      array(p + 8, section.mappedSize, 1));
+	    section.numHeaders = get_uint(p + 24, 4);
+	    // the text reader counts at most one header per input line
+	    if (section.numHeaders > text.size()) {
+		throw corrupt();
+	    }
+	    std::uint32_t numComments = get_uint(p + 28, 4);
+	    for (std::uint32_t i = 0; i < numComments; ++i) {
+		if (!strip) {
+		    section.annotations.push_back(
+		      { get_uint(comment, 8), string(comment + 8) });
+		}
+		comment += commentSize;
+	    }
+	}
+	hasBss = flags & 4;
+	bssAlignment = get_uint(h + 80, 8);
+	bssSize = get_uint(h + 88, 8);
+	if (hasBss && !isAlignment(bssAlignment)) {
+	    throw corrupt();
+	}
+
+	std::uint64_t numSymbols = get_uint(h + 104, 8);
+	const char *p = array(h + 96, numSymbols, symbolSize);
+	symbols.reserve(numSymbols);
+	for (std::uint64_t i = 0; i < numSymbols; ++i, p += symbolSize) {
+	    symbols.push_back({ static_cast<char>(get_uint(p + 16, 4)),
+				string(p + 8), get_uint(p, 8) });
+	}
+
+	std::uint64_t numFixups = get_uint(h + 120, 8);
+	p = array(h + 112, numFixups, fixupSize);
+	fixups.reserve(numFixups);
+	for (std::uint64_t i = 0; i < numFixups; ++i, p += fixupSize) {
+	    Fixup fix{ string(p + 16),
+		       get_uint(p, 8),
+		       static_cast<std::int64_t>(get_uint(p + 8, 8)),
+		       static_cast<std::uint8_t>(p[24]),
+		       static_cast<FixKind>(p[25]),
+		       static_cast<std::uint8_t>(p[26]),
+		       static_cast<std::uint8_t>(p[27]) };
+	    if (fix.seg > 1 ||
+		static_cast<std::uint8_t>(p[25]) > std::uint8_t(FixKind::W3) ||
+		fix.numBytes > 8 || fix.addr > sections[fix.seg].mappedSize ||
+		fix.numBytes > sections[fix.seg].mappedSize - fix.addr)
+	    {
+		throw corrupt();
+	    }
+	    fixups.push_back(fix);
+	}
+	numCorrupted = get_uint(h + 152, 8);
+    }
+
+    void
+    writeBinary(io::output_buffer &out) const
+    {
+	using codec::put_uint;
+
+	std::uint64_t offset = binaryHeaderSize;
+	std::uint64_t sectionOffset[2];
+	for (std::size_t seg = 0; seg < 2; ++seg) {
+	    sectionOffset[seg] = offset;
+	    offset = (offset + sections[seg].size() + 7) / 8 * 8;
+	}
+	std::uint64_t symbolsOffset = offset;
+	offset += symbols.size() * symbolSize;
+	std::uint64_t fixupsOffset = offset;
+	offset += fixups.size() * fixupSize;
+	std::uint64_t commentsOffset = offset;
+	std::uint64_t stringsSize = 0;
+	for (auto &sym : symbols) {
+	    stringsSize += sym.ident.size();
+	}
+	for (auto &fix : fixups) {
+	    stringsSize += fix.ident.size();
+	}
+	for (auto &section : sections) {
+	    offset += section.annotations.size() * commentSize;
+	    for (auto &annotation : section.annotations) {
+		stringsSize += annotation.second.size();
+	    }
+	}
+	std::uint64_t stringsOffset = offset;
+
+	out.put(std::string_view(binaryMagic, sizeof(binaryMagic)));
+	put_uint(out, binaryVersion, 4);
+	put_uint(out,
+		sections[0].present | sections[1].present << 1 | hasBss << 2,
+		4);
+	for (std::size_t seg = 0; seg < 2; ++seg) {
+	    put_uint(out, sections[seg].alignment, 8);
+	    put_uint(out, sectionOffset[seg], 8);
+	    put_uint(out, sections[seg].size(), 8);
+	    put_uint(out, sections[seg].numHeaders, 4);
+	    put_uint(out, sections[seg].annotations.size(), 4);
+	}
+	put_uint(out, bssAlignment, 8);
+	put_uint(out, bssSize, 8);
+	put_uint(out, symbolsOffset, 8);
+	put_uint(out, symbols.size(), 8);
+	put_uint(out, fixupsOffset, 8);
+	put_uint(out, fixups.size(), 8);
+	put_uint(out, commentsOffset, 8);
+	put_uint(out, stringsOffset, 8);
+	put_uint(out, stringsSize, 8);
+	put_uint(out, numCorrupted, 8);
+
+	for (std::size_t seg = 0; seg < 2; ++seg) {
+	    const Section &section = sections[seg];
+	    out.put(std::string_view(
+	      reinterpret_cast<const char *>(section.data()), section.size()));
+	    out.put_fill('\0', (8 - section.size() % 8) % 8);
+	}
+	std::uint64_t stringOffset = 0;
+	auto putString = [&](std::string_view s) {
+	    put_uint(out, stringOffset, 4);
+	    put_uint(out, s.size(), 4);
+	    stringOffset += s.size();
+	};
+	for (auto &sym : symbols) {
+	    put_uint(out, sym.value, 8);
+	    putString(sym.ident);
+	    put_uint(out, static_cast<unsigned char>(sym.kind), 4);
+	    put_uint(out, 0, 4);
+	}
+	for (auto &fix : fixups) {
+	    put_uint(out, fix.addr, 8);
+	    put_uint(out, fix.displace, 8);
+	    putString(fix.ident);
+	    put_uint(out, fix.seg, 1);
+	    put_uint(out, std::uint8_t(fix.kind), 1);
+	    put_uint(out, fix.offset, 1);
+	    put_uint(out, fix.numBytes, 1);
+	    put_uint(out, 0, 4);
+	}
+	for (auto &section : sections) {
+	    for (auto &[size, comment] : section.annotations) {
+		put_uint(out, size, 8);
+		putString(comment);
+	    }
+	}
+	for (auto &sym : symbols) {
+	    out.put(sym.ident);
+	}
+	for (auto &fix : fixups) {
+	    out.put(fix.ident);
+	}
+	for (auto &section : sections) {
+	    for (auto &annotation : section.annotations) {
+		out.put(annotation.second);
+	    }
+	}
+    }
+
+    std::string source;
+    io::mapped_file mapping;
+    Section sections[2]; // text and data
+    bool hasBss;
+    std::uint64_t bssAlignment, bssSize;
+    std::vector<Symbol> symbols;
+    std::vector<Fixup> fixups;
+    std::size_t numCorrupted; // bytes not given in hex format
+    std::size_t numLines; // of the textual source, 0 for binary objects
+};
+
+#endif // PARSED_OBJECT_HPP
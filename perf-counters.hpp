@@ -0,0 +1,149 @@
+/*
+   Performance counters of the calling process (including the threads it
+   creates afterwards) by perf_event_open(2) on Linux:
+
+      perf::counters counters;
+      auto before = counters.read();
+      // ...
+      for (auto &[name, value] : counters.difference(before, counters.read())) {
+	 // ...
+      }
+
+   Counted are cycles, instructions, cache misses, branch misses and page
+   faults in user space. Events that cannot be opened (no hardware
+   support, virtual machines, restrictive perf_event_paranoid or other
+   operating systems) are silently left out; available() tells whether
+   any event is counted at all. If the kernel multiplexes the hardware
+   counters, counts are scaled by the fraction of time they ran.
+*/
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+
+class counters
+{
+  public:
+    static constexpr std::size_t num_events = 5;
+
+    struct sample
+    {
+	/* value, time enabled and time running per event */
+	std::array<std::array<std::uint64_t, 3>, num_events> values{};
+    };
+
+    counters()
+    {
+	fds.fill(-1);
+#ifdef __linux__
+	static constexpr std::pair<std::uint32_t, std::uint64_t>
+	  events[num_events] = {
+	      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+	  };
+	for (std::size_t i = 0; i < num_events; ++i) {
+	    struct perf_event_attr attr;
+	    std::memset(&attr, 0, sizeof(attr));
+	    attr.size = sizeof(attr);
+	    attr.type = events[i].first;
+	    attr.config = events[i].second;
+	    attr.read_format =
+	      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	    attr.inherit = 1;
+	    attr.exclude_kernel = 1;
+	    attr.exclude_hv = 1;
+	    fds[i] = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0,
+						-1, -1, PERF_FLAG_FD_CLOEXEC));
+	}
+#endif
+    }
+
+    counters(const counters &) = delete;
+    counters &operator=(const counters &) = delete;
+
+    ~counters()
+    {
+#ifdef __linux__
+	for (int fd : fds) {
+	    if (fd >= 0) {
+		::close(fd);
+	    }
+	}
+#endif
+    }
+
+    bool
+    available() const
+    {
+	for (int fd : fds) {
+	    if (fd >= 0) {
+		return true;
+	    }
+	}
+	return false;
+    }
+
+    sample
+    read() const
+    {
+	sample s;
+#ifdef __linux__
+	for (std::size_t i = 0; i < num_events; ++i) {
+	    if (fds[i] >= 0 &&
+		::read(fds[i], s.values[i].data(), sizeof(s.values[i])) !=
+		  sizeof(s.values[i]))
+	    {
+		s.values[i].fill(0);
+	    }
+	}
+#endif
+	return s;
+    }
+
+    /* names and counts of the available events between two samples */
+    std::vector<std::pair<const char *, std::uint64_t>>
+    difference(const sample &from, const sample &to) const
+    {
+	static constexpr const char *names[num_events] = {
+	    "cycles", "instructions", "cache_misses", "branch_misses",
+	    "page_faults",
+	};
+	std::vector<std::pair<const char *, std::uint64_t>> result;
+	for (std::size_t i = 0; i < num_events; ++i) {
+	    if (fds[i] < 0) {
+		continue;
+	    }
+	    double value = to.values[i][0] - from.values[i][0];
+	    std::uint64_t enabled = to.values[i][1] - from.values[i][1];
+	    std::uint64_t running = to.values[i][2] - from.values[i][2];
+	    if (running > 0 && running < enabled) {
+		value = value * enabled / running;
+	    }
+	    result.emplace_back(names[i], static_cast<std::uint64_t>(value));
+	}
+	return result;
+    }
+
+  private:
+    std::array<int, num_events> fds;
+};
+
+} // namespace perf
+
+#endif // PERF_COUNTERS_HPP
@@ -0,0 +1,188 @@
+/*
+   Wall clock and CPU time of the consecutive phases of a run together
+   with named counts, written as JSON:
+
+      stats::report report;
+      report.phase("parse");
+      // ...
+      report.phase("link");	// ends the previous phase
+      // ...
+      report.stop();
+      report.count("files", numFiles);
+      report.write_json(std::cerr);
+
+   CPU time is that of the whole process, i.e. it includes all threads
+   and may exceed the wall clock time of a phase. Times are given in
+   seconds, phases and counts in the order they were recorded. The total
+   reaches from the begin of the first phase to the end of the last one.
+
+   After enable_counters(), each phase also reports the hardware
+   counters of perf::counters. Whether any of them could be opened is
+   given by "counters_available"; unavailable events are omitted.
+*/
+
+#ifndef PHASE_STATS_HPP
+#define PHASE_STATS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/* POSIX headers */
+#include <time.h>
+
+#include "json-string.hpp"
+#include "perf-counters.hpp"
+
+namespace stats {
+
+namespace internal {
+
+inline double
+wall_time()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline double
+cpu_time()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) < 0) {
+	return 0;
+    }
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+} // namespace internal
+
+class report
+{
+  public:
+    report()
+      : running(false)
+      , start_wall(0)
+      , start_cpu(0)
+      , end_wall(0)
+      , end_cpu(0)
+    {
+    }
+
+    /* to be called before the first phase */
+    void
+    enable_counters()
+    {
+	if (!hw) {
+	    hw = std::make_unique<perf::counters>();
+	}
+    }
+
+    /* ends the current phase, if any, and starts the next one */
+    void
+    phase(std::string name)
+    {
+	stop();
+	phases.push_back({ std::move(name), internal::wall_time(),
+			   internal::cpu_time(), {} });
+	if (phases.size() == 1) {
+	    start_wall = end_wall = phases.back().wall;
+	    start_cpu = end_cpu = phases.back().cpu;
+	}
+	if (hw) {
+	    begin_sample = hw->read();
+	}
+	running = true;
+    }
+
+    void
+    stop()
+    {
+	if (running) {
+	    auto &current = phases.back();
+	    if (hw) {
+		current.counters = hw->difference(begin_sample, hw->read());
+	    }
+	    end_wall = internal::wall_time();
+	    end_cpu = internal::cpu_time();
+	    current.wall = end_wall - current.wall;
+	    current.cpu = end_cpu - current.cpu;
+	    running = false;
+	}
+    }
+
+    void
+    count(std::string name, std::uint64_t value)
+    {
+	counts.emplace_back(std::move(name), value);
+    }
+
+    void
+    write_json(std::ostream &out) const
+    {
+	auto flags = out.flags();
+	auto precision = out.precision();
+	out << std::fixed << std::setprecision(6) << "{\n  \"phases\": [";
+	for (std::size_t i = 0; i < phases.size(); ++i) {
+	    out << (i ? ",\n" : "\n") << "    { \"name\": ";
+	    json::put_string(out, phases[i].name);
+	    out << ", \"wall\": " << phases[i].wall
+		<< ", \"cpu\": " << phases[i].cpu;
+	    if (hw && hw->available()) {
+		out << ", \"counters\": {";
+		const auto &counters = phases[i].counters;
+		for (std::size_t j = 0; j < counters.size(); ++j) {
+		    out << (j ? ", " : " ") << '"' << counters[j].first
+			<< "\": " << counters[j].second;
+		}
+		out << " }";
+	    }
+	    out << " }";
+	}
+	out << "\n  ],\n";
+	if (hw) {
+	    out << "  \"counters_available\": "
+		<< (hw->available() ? "true" : "false") << ",\n";
+	}
+	double wall = running ? internal::wall_time() : end_wall;
+	double cpu = running ? internal::cpu_time() : end_cpu;
+	out << "  \"total\": { \"wall\": " << wall - start_wall
+	    << ", \"cpu\": " << cpu - start_cpu
+	    << " },\n  \"counts\": {";
+	for (std::size_t i = 0; i < counts.size(); ++i) {
+	    out << (i ? ",\n" : "\n") << "    ";
+	    json::put_string(out, counts[i].first);
+	    out << ": " << counts[i].second;
+	}
+	out << "\n  }\n}\n";
+	out.flags(flags);
+	out.precision(precision);
+    }
+
+  private:
+    struct phase_times
+    {
+	std::string name;
+	/* begin of the phase while it is running */
+	double wall, cpu;
+	std::vector<std::pair<const char *, std::uint64_t>> counters;
+    };
+
+    bool running;
+    /* begin of the first phase and end of the last stopped phase */
+    double start_wall, start_cpu, end_wall, end_cpu;
+    std::unique_ptr<perf::counters> hw;
+    perf::counters::sample begin_sample;
+    std::vector<phase_times> phases;
+    std::vector<std::pair<std::string, std::uint64_t>> counts;
+};
+
+} // namespace stats
+
+#endif // PHASE_STATS_HPP
@@ -0,0 +1,142 @@
+/*
+   Allocation-free scanning of line-oriented text held in memory, e.g.
+   the contents of a mapped object file or archive member. All functions
+   operate on std::string_view slices of the underlying text and advance
+   the given view past whatever they consumed:
+
+      std::string_view text = ..., line;
+      while (scan::next_line(text, line)) {
+	 std::string_view ident = scan::next_token(line);
+	 std::uint64_t value;
+	 if (scan::parse_hex(line, value)) {
+	    // ...
+	 }
+      }
+
+   Numbers are parsed like the corresponding iostream extractors: leading
+   white space is skipped and hexadecimal values may carry a 0x prefix.
+*/
+
+#ifndef TEXT_SCANNER_HPP
+#define TEXT_SCANNER_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+namespace scan {
+
+inline bool
+is_space(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f' ||
+	   ch == '\v';
+}
+
+inline bool
+starts_with(std::string_view s, std::string_view prefix)
+{
+    return s.substr(0, prefix.size()) == prefix;
+}
+
+/* returns the next line of text (without its '\n') like std::getline */
+inline bool
+next_line(std::string_view &text, std::string_view &line)
+{
+    if (text.empty()) {
+	return false;
+    }
+    std::size_t pos = text.find('\n');
+    if (pos == std::string_view::npos) {
+	line = text;
+	text = std::string_view();
+    } else {
+	line = text.substr(0, pos);
+	text.remove_prefix(pos + 1);
+    }
+    return true;
+}
+
+inline void
+skip_space(std::string_view &s)
+{
+    std::size_t i = 0;
+    while (i < s.size() && is_space(s[i])) {
+	++i;
+    }
+    s.remove_prefix(i);
+}
+
+inline bool
+is_blank(std::string_view s)
+{
+    skip_space(s);
+    return s.empty();
+}
+
+/* returns the next white space delimited token, empty if there is none */
+inline std::string_view
+next_token(std::string_view &s)
+{
+    skip_space(s);
+    std::size_t i = 0;
+    while (i < s.size() && !is_space(s[i])) {
+	++i;
+    }
+    std::string_view token = s.substr(0, i);
+    s.remove_prefix(i);
+    return token;
+}
+
+template<typename T>
+bool
+parse_unsigned(std::string_view &s, T &value, int base)
+{
+    skip_space(s);
+    if (base == 16 && s.size() > 2 && s[0] == '0' &&
+	(s[1] == 'x' || s[1] == 'X'))
+    {
+	s.remove_prefix(2);
+    }
+    auto res = std::from_chars(s.data(), s.data() + s.size(), value, base);
+    if (res.ec != std::errc()) {
+	return false;
+    }
+    s.remove_prefix(res.ptr - s.data());
+    return true;
+}
+
+inline bool
+parse_dec(std::string_view &s, std::uint64_t &value)
+{
+    return parse_unsigned(s, value, 10);
+}
+
+inline bool
+parse_hex(std::string_view &s, std::uint64_t &value)
+{
+    return parse_unsigned(s, value, 16);
+}
+
+/* decimal value with an optional sign */
+inline bool
+parse_signed(std::string_view &s, std::int64_t &value)
+{
+    skip_space(s);
+    bool negative = false;
+    if (!s.empty() && (s[0] == '+' || s[0] == '-')) {
+	negative = s[0] == '-';
+	s.remove_prefix(1);
+    }
+    std::uint64_t magnitude;
+    if (!parse_unsigned(s, magnitude, 10)) {
+	return false;
+    }
+    value = negative ? -static_cast<std::int64_t>(magnitude)
+		     : static_cast<std::int64_t>(magnitude);
+    return true;
+}
+
+} // namespace scan
+
+#endif // TEXT_SCANNER_HPP
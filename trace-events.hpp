@@ -0,0 +1,168 @@
+/*
+   Timeline of spans in the trace event format which is understood by
+   chrome://tracing and Perfetto:
+
+      trace::recorder tracer;
+      tracer.enable();
+      {
+	 trace::span span(tracer, "parse", "parse", filename);
+	 // ...
+      }				// the span ends here
+      tracer.write_json(out);
+
+   Spans are recorded as complete events when they end, each together
+   with a small number for its thread (1 for the first thread that
+   records anything, usually the main thread). Spans may be recorded
+   concurrently by multiple threads. Nothing is recorded unless the
+   recorder is enabled, and a span of a disabled recorder neither reads
+   the clock nor copies its strings.
+*/
+
+#ifndef TRACE_EVENTS_HPP
+#define TRACE_EVENTS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json-string.hpp"
+
+namespace trace {
+
+namespace internal {
+
+inline unsigned
+thread_number()
+{
+    static std::atomic<unsigned> num_threads{ 0 };
+    thread_local unsigned number = ++num_threads;
+    return number;
+}
+
+} // namespace internal
+
+class recorder
+{
+  public:
+    recorder()
+      : is_enabled(false)
+      , start(std::chrono::steady_clock::now())
+    {
+    }
+
+    void
+    enable()
+    {
+	is_enabled = true;
+    }
+
+    bool
+    enabled() const
+    {
+	return is_enabled;
+    }
+
+    /* microseconds since the construction of the recorder */
+    std::uint64_t
+    now() const
+    {
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now() - start)
+	  .count();
+    }
+
+    void
+    add(std::string_view name, std::string_view category,
+	std::string_view detail, std::uint64_t begin, std::uint64_t end)
+    {
+	event ev{ std::string(name), std::string(category),
+		  std::string(detail), begin, end - begin,
+		  internal::thread_number() };
+	std::lock_guard<std::mutex> lock(mutex);
+	events.push_back(std::move(ev));
+    }
+
+    void
+    write_json(std::ostream &out) const
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	out << "{\"traceEvents\":[";
+	for (std::size_t i = 0; i < events.size(); ++i) {
+	    const event &ev = events[i];
+	    out << (i ? ",\n" : "\n") << "{\"name\":";
+	    json::put_string(out, ev.name);
+	    out << ",\"cat\":";
+	    json::put_string(out, ev.category);
+	    out << ",\"ph\":\"X\",\"ts\":" << ev.begin
+		<< ",\"dur\":" << ev.duration << ",\"pid\":1,\"tid\":"
+		<< ev.thread;
+	    if (!ev.detail.empty()) {
+		out << ",\"args\":{\"detail\":";
+		json::put_string(out, ev.detail);
+		out << "}";
+	    }
+	    out << "}";
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+  private:
+    struct event
+    {
+	std::string name, category, detail;
+	std::uint64_t begin, duration;
+	unsigned thread;
+    };
+
+    bool is_enabled;
+    std::chrono::steady_clock::time_point start;
+    mutable std::mutex mutex;
+    std::vector<event> events;
+};
+
+class span
+{
+  public:
+    span(recorder &tracer, std::string_view name, std::string_view category,
+	 std::string_view detail = std::string_view())
+      : tracer(tracer.enabled() ? &tracer : nullptr)
+      , name(name)
+      , category(category)
+      , detail(detail)
+      , begin(this->tracer ? tracer.now() : 0)
+    {
+    }
+
+    span(const span &) = delete;
+    span &operator=(const span &) = delete;
+
+    ~span()
+    {
+	end();
+    }
+
+    /* ends the span before its destruction */
+    void
+    end()
+    {
+	if (tracer) {
+	    tracer->add(name, category, detail, begin, tracer->now());
+	    tracer = nullptr;
+	}
+    }
+
+  private:
+    recorder *tracer;
+    /* must stay valid until the span ends */
+    std::string_view name, category, detail;
+    std::uint64_t begin;
+};
+
+} // namespace trace
+
+#endif // TRACE_EVENTS_HPP
@@ -0,0 +1,450 @@
+/*
+   Binary executable images for the ULM as an alternative to the textual
+   format (a listing of hex bytes) written by ulmld:
+
+      image::contents img;
+      // fill in img.text, img.data, img.bss, img.symbols, ...
+      image::write(out, img);		// out is an io::output_buffer
+
+      io::mapped_file file(filename);
+      image::contents img;
+      if (image::read(file.contents(), img)) {
+	 // img.text.bytes etc. point into the mapped file
+      }
+
+   An image is little endian and starts with a header of fixed size:
+
+      offset  size
+	   0     8  magic "\177ULMIMG\0"
+	   8     4  version
+	  12     4  flags (bit 0: symbol table present)
+	  16     8  entry address
+	  24    32  text: base address, size, alignment, file offset
+	  56    32  data: base address, size, alignment, file offset
+	  88    24  bss: base address, size, alignment
+	 112    16  interpreter path: file offset, length
+	 128    16  symbol table: file offset, number of symbols
+
+   The contents of the text and data segment are stored at offsets that
+   are multiples of page_size such that they can be mapped directly. The
+   symbol table consists of 16 byte entries (value, offset of the name
+   within the string table, kind as 32 bit values) followed by the string
+   table with NUL-terminated names.
+
+   Textual images can be converted by parse_listing and write_listing.
+   Comments, labels and "# from:" headers of a listing are not kept.
+*/
+
+#ifndef ULM_IMAGE_HPP
+#define ULM_IMAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "binary-codec.hpp"
+#include "hex-decode.hpp"
+#include "output-buffer.hpp"
+#include "text-scanner.hpp"
+
+namespace image {
+
+constexpr char magic[8] = { '\177', 'U', 'L', 'M', 'I', 'M', 'G', '\0' };
+constexpr std::uint32_t version = 1;
+constexpr std::uint32_t has_symbols = 1;
+constexpr std::uint64_t page_size = 4096;
+constexpr std::size_t header_size = 144;
+constexpr std::size_t symbol_size = 16;
+
+struct segment
+{
+    std::uint64_t base = 0, size = 0, alignment = 1;
+    // contents of size bytes, empty for the bss segment
+    std::string_view bytes;
+};
+
+struct symbol
+{
+    char kind;
+    std::string_view name;
+    std::uint64_t value;
+};
+
+struct contents
+{
+    std::string_view interpreter;
+    std::uint64_t entry = 0;
+    segment text, data, bss;
+    bool with_symbols = true;
+    std::vector<symbol> symbols;
+};
+
+namespace internal {
+
+inline std::uint64_t
+align(std::uint64_t offset, std::uint64_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/* ulmld prints the alignment of the bss segment in hex if the data
+   segment is not empty; as alignments are powers of 2 this is detected
+   by a decimal value that is not a power of 2 */
+inline bool
+parse_alignment(std::string_view &s, std::uint64_t &alignment)
+{
+    std::string_view rest = s;
+    if (!scan::parse_dec(rest, alignment)) {
+	return false;
+    }
+    if (alignment & (alignment - 1)) {
+	rest = s;
+	if (!scan::parse_hex(rest, alignment)) {
+	    return false;
+	}
+    }
+    s = rest;
+    return true;
+}
+
+/* appends the hex digits of one line of a listing to bytes */
+inline bool
+append_hex(std::string_view line, std::string &bytes)
+{
+    std::string digits;
+    for (char ch : line) {
+	if (!scan::is_space(ch)) {
+	    digits.push_back(ch);
+	}
+    }
+    if (digits.size() % 2) {
+	return false;
+    }
+    std::size_t pos = bytes.size();
+    bytes.resize(pos + digits.size() / 2);
+    return hex::decode(digits.data(), digits.size() / 2,
+		       reinterpret_cast<unsigned char *>(&bytes[pos])) == 0;
+}
+
+/* bytes in lines of at most 4 bytes with addresses as written by ulmld */
+inline void
+write_lines(io::output_buffer &out, const segment &seg)
+{
+    if (seg.size == 0) {
+	return;
+    }
+    std::uint64_t addr = seg.base;
+    out.put("0x");
+    out.put_hex(addr, 16);
+    out.put(": ");
+    if (addr % 4 != 0) {
+	out.put_spaces(3 * (addr % 4));
+    }
+    for (unsigned char byte : seg.bytes) {
+	out.put_hex_byte(byte);
+	out.put(' ');
+	if (addr++ % 4 == 3) {
+	    out.put('\n');
+	    out.put_spaces(20);
+	}
+    }
+    out.put('\n');
+}
+
+} // namespace internal
+
+inline void
+write(io::output_buffer &out, const contents &img)
+{
+    using internal::align;
+    using codec::put_uint;
+
+    std::uint64_t interp_offset = header_size;
+    std::uint64_t text_offset =
+      align(interp_offset + img.interpreter.size(), page_size);
+    std::uint64_t data_offset = align(text_offset + img.text.size, page_size);
+    std::uint64_t symtab_offset = align(data_offset + img.data.size, 8);
+    std::size_t num_symbols = img.with_symbols ? img.symbols.size() : 0;
+
+    out.put(std::string_view(magic, sizeof(magic)));
+    put_uint(out, version, 4);
+    put_uint(out, img.with_symbols ? has_symbols : 0, 4);
+    put_uint(out, img.entry, 8);
+    for (auto seg : { &img.text, &img.data }) {
+	put_uint(out, seg->base, 8);
+	put_uint(out, seg->size, 8);
+	put_uint(out, seg->alignment, 8);
+	put_uint(out, seg == &img.text ? text_offset : data_offset, 8);
+    }
+    put_uint(out, img.bss.base, 8);
+    put_uint(out, img.bss.size, 8);
+    put_uint(out, img.bss.alignment, 8);
+    put_uint(out, interp_offset, 8);
+    put_uint(out, img.interpreter.size(), 8);
+    put_uint(out, img.with_symbols ? symtab_offset : 0, 8);
+    put_uint(out, num_symbols, 8);
+
+    out.put(img.interpreter);
+    out.put_fill('\0', text_offset - interp_offset - img.interpreter.size());
+    out.put(img.text.bytes);
+    out.put_fill('\0', data_offset - text_offset - img.text.size);
+    out.put(img.data.bytes);
+    if (!img.with_symbols) {
+	return;
+    }
+    out.put_fill('\0', symtab_offset - data_offset - img.data.size);
+    std::uint64_t name_offset = 0;
+    for (const auto &sym : img.symbols) {
+	put_uint(out, sym.value, 8);
+	put_uint(out, name_offset, 4);
+	put_uint(out, static_cast<unsigned char>(sym.kind), 4);
+	name_offset += sym.name.size() + 1;
+    }
+    for (const auto &sym : img.symbols) {
+	out.put(sym.name);
+	out.put('\0');
+    }
+}
+
+/* checks just the header size and the magic string */
+inline bool
+is_image(std::string_view file)
+{
+    return file.size() >= header_size &&
+	   file.substr(0, sizeof(magic)) ==
+	     std::string_view(magic, sizeof(magic));
+}
+
+/* returns false if file is not a valid image */
+inline bool
+read(std::string_view file, contents &img)
+{
+    using codec::get_uint;
+
+    if (!is_image(file) || get_uint(&file[8], 4) != version) {
+	return false;
+    }
+    /* views of size bytes at the offset found at p */
+    auto view = [file](const char *p, std::uint64_t size,
+		       std::string_view &v) {
+	std::uint64_t offset = get_uint(p, 8);
+	if (offset > file.size() || size > file.size() - offset) {
+	    return false;
+	}
+	v = file.substr(offset, size);
+	return true;
+    };
+    const char *h = file.data();
+    img.with_symbols = get_uint(h + 12, 4) & has_symbols;
+    img.entry = get_uint(h + 16, 8);
+    segment *segs[] = { &img.text, &img.data };
+    for (int i = 0; i < 2; ++i) {
+	const char *p = h + 24 + 32 * i;
+	segs[i]->base = get_uint(p, 8);
+	segs[i]->size = get_uint(p + 8, 8);
+	segs[i]->alignment = get_uint(p + 16, 8);
+	if (!view(p + 24, segs[i]->size, segs[i]->bytes)) {
+	    return false;
+	}
+    }
+    img.bss.base = get_uint(h + 88, 8);
+    img.bss.size = get_uint(h + 96, 8);
+    img.bss.alignment = get_uint(h + 104, 8);
+    img.bss.bytes = std::string_view();
+    if (!view(h + 112, get_uint(h + 120, 8), img.interpreter)) {
+	return false;
+    }
+
+    img.symbols.clear();
+    if (!img.with_symbols) {
+	return true;
+    }
+    std::uint64_t num_symbols = get_uint(h + 136, 8);
+    std::string_view table;
+    if (num_symbols > file.size() / symbol_size ||
+	!view(h + 128, num_symbols * symbol_size, table))
+    {
+	return false;
+    }
+    const char *names = table.data() + table.size();
+    std::size_t names_len = file.data() + file.size() - names;
+    for (std::uint64_t i = 0; i < num_symbols; ++i) {
+	const char *p = table.data() + i * symbol_size;
+	std::uint64_t name_offset = get_uint(p + 8, 4);
+	if (name_offset >= names_len) {
+	    return false;
+	}
+	auto end = static_cast<const char *>(std::memchr(
+	  names + name_offset, 0, names_len - name_offset));
+	if (!end) {
+	    return false;
+	}
+	const char *name = names + name_offset;
+	img.symbols.push_back({ static_cast<char>(get_uint(p + 12, 4)),
+				std::string_view(name, end - name),
+				get_uint(p, 8) });
+    }
+    return true;
+}
+
+/*
+   Parses a textual image as written by ulmld (with or without -s).
+   The bytes of the segments are stored in text_bytes and data_bytes
+   which must live as long as img is used. Returns false if text is not
+   a valid listing.
+*/
+inline bool
+parse_listing(std::string_view text, contents &img, std::string &text_bytes,
+	      std::string &data_bytes)
+{
+    enum { none, text_seg, data_seg, symtab } section = none;
+    bool have_addr[2] = { false, false };
+    std::string *bytes[2] = { &text_bytes, &data_bytes };
+    segment *segs[2] = { &img.text, &img.data };
+    bool have_bss_base = false;
+    std::string_view line;
+
+    img = contents();
+    text_bytes.clear();
+    data_bytes.clear();
+    if (!scan::next_line(text, line) || !scan::starts_with(line, "#!")) {
+	return false;
+    }
+    std::size_t pos = line.find("-S ");
+    img.interpreter =
+      pos == std::string_view::npos ? line.substr(2) : line.substr(pos + 3);
+
+    while (scan::next_line(text, line)) {
+	if (scan::starts_with(line, "#TEXT") ||
+	    scan::starts_with(line, "#DATA"))
+	{
+	    section = line[1] == 'T' ? text_seg : data_seg;
+	    line.remove_prefix(5);
+	    if (!scan::parse_dec(line, segs[section - text_seg]->alignment)) {
+		return false;
+	    }
+	    continue;
+	}
+	if (scan::starts_with(line, "#BSS")) {
+	    section = none;
+	    line.remove_prefix(4);
+	    if (!internal::parse_alignment(line, img.bss.alignment) ||
+		!scan::parse_dec(line, img.bss.size))
+	    {
+		return false;
+	    }
+	    continue;
+	}
+	if (scan::starts_with(line, "#(begins at")) {
+	    line.remove_prefix(11);
+	    have_bss_base = scan::parse_hex(line, img.bss.base);
+	    continue;
+	}
+	if (scan::starts_with(line, "#SYMTAB")) {
+	    section = symtab;
+	    continue;
+	}
+	if (scan::starts_with(line, "#") || scan::is_blank(line)) {
+	    continue;
+	}
+	if (section == symtab) {
+	    scan::skip_space(line);
+	    symbol sym;
+	    sym.kind = line[0];
+	    line.remove_prefix(1);
+	    sym.name = scan::next_token(line);
+	    if (!scan::parse_hex(line, sym.value)) {
+		return false;
+	    }
+	    img.symbols.push_back(sym);
+	    continue;
+	}
+	if (section == none) {
+	    return false;
+	}
+	int i = section - text_seg;
+	line = line.substr(0, line.find('#'));
+	if (std::size_t colon = line.find(':');
+	    colon != std::string_view::npos)
+	{
+	    std::string_view field = line.substr(0, colon);
+	    std::uint64_t addr;
+	    if (!scan::parse_hex(field, addr)) {
+		return false;
+	    }
+	    if (!have_addr[i]) {
+		segs[i]->base = addr;
+		have_addr[i] = true;
+	    } else if (addr != segs[i]->base + bytes[i]->size()) {
+		return false;
+	    }
+	    line.remove_prefix(colon + 1);
+	}
+	if (!internal::append_hex(line, *bytes[i])) {
+	    return false;
+	}
+    }
+
+    /* listings without addresses (ulmld -s) */
+    if (!have_addr[1]) {
+	img.data.base = internal::align(img.text.base + text_bytes.size(),
+					img.data.alignment);
+    }
+    if (!have_bss_base) {
+	img.bss.base = internal::align(img.data.base + data_bytes.size(),
+				       img.bss.alignment);
+    }
+    for (int i = 0; i < 2; ++i) {
+	segs[i]->bytes = *bytes[i];
+	segs[i]->size = bytes[i]->size();
+    }
+    img.entry = img.text.base;
+    return true;
+}
+
+/* writes img as textual image in the format of ulmld */
+inline void
+write_listing(io::output_buffer &out, const contents &img)
+{
+    out.put("#!/usr/bin/env -S ");
+    out.put(img.interpreter);
+    out.put("\n#TEXT ");
+    out.put_dec(img.text.alignment);
+    out.put('\n');
+    internal::write_lines(out, img.text);
+    out.put("#DATA ");
+    out.put_dec(img.data.alignment);
+    out.put('\n');
+    internal::write_lines(out, img.data);
+    /* like ulmld, see parse_alignment */
+    out.put("#BSS ");
+    if (img.data.size) {
+	out.put_hex(img.bss.alignment);
+    } else {
+	out.put_dec(img.bss.alignment);
+    }
+    out.put(' ');
+    out.put_dec(img.bss.size);
+    out.put("\n#(begins at 0x");
+    out.put_hex(img.bss.base);
+    out.put(")\n#SYMTAB \n");
+    for (const auto &sym : img.symbols) {
+	out.put(sym.kind);
+	out.put(' ');
+	out.put(sym.name);
+	if (sym.name.size() < 27) {
+	    out.put_spaces(27 - sym.name.size());
+	}
+	out.put(" 0x");
+	out.put_hex(sym.value, 16);
+	out.put('\n');
+    }
+}
+
+} // namespace image
+
+#endif // ULM_IMAGE_HPP
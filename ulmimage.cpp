@@ -0,0 +1,70 @@
+/*
+   Converts between the textual executables written by ulmld and binary
+   images (see ulm-image.hpp): a textual input is converted into a binary
+   image and vice versa. With -s no symbol table is put into a binary
+   image.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <printf.hpp>
+#include "mapped-file.hpp"
+#include "output-buffer.hpp"
+#include "ulm-image.hpp"
+
+/* POSIX headers */
+#include <fcntl.h>
+#include <unistd.h>
+
+int
+main(int argc, char** argv)
+{
+    const char *cmdname = *argv++; --argc;
+    bool strip = false;
+    if (argc > 0 && !std::strcmp(*argv, "-s")) {
+	strip = true;
+	++argv; --argc;
+    }
+    if (argc != 2) {
+	fmt::printf(std::cerr, "Usage: %s [-s] infile outfile\n", cmdname);
+	std::exit(1);
+    }
+    const char *infile = argv[0];
+    const char *outfile = argv[1];
+
+    io::mapped_file in(infile);
+    if (!in.is_open()) {
+	fmt::printf(std::cerr, "%s: can not open %s\n", cmdname, infile);
+	std::exit(1);
+    }
+    image::contents img;
+    std::string text_bytes, data_bytes;
+    bool binary = image::is_image(in.contents());
+    if (binary ? !image::read(in.contents(), img)
+	       : !image::parse_listing(in.contents(), img, text_bytes,
+				       data_bytes))
+    {
+	fmt::printf(std::cerr, "%s: %s is not a valid %s\n", cmdname, infile,
+		    binary ? "image" : "executable");
+	std::exit(1);
+    }
+
+    int fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0777);
+    if (fd < 0) {
+	fmt::printf(std::cerr, "%s: can not create %s\n", cmdname, outfile);
+	std::exit(1);
+    }
+    io::output_buffer out(fd);
+    if (binary) {
+	image::write_listing(out, img);
+    } else {
+	img.with_symbols = !strip;
+	image::write(out, img);
+    }
+    if (!out.flush() || close(fd) < 0) {
+	fmt::printf(std::cerr, "%s: can not write %s\n", cmdname, outfile);
+	std::remove(outfile);
+	std::exit(1);
+    }
+}
@@ -1,89 +1,42 @@
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cctype>
 #include <cinttypes>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <optional>
-#include <set>
+#include <queue>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 // POSIX
+#include <dirent.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "archive-index.hpp"
 #include "archive-reader.hpp"
-
-class Exception : public std::exception
-{
-  private:
-    bool showAddress;
-    std::uint64_t address;
-    std::string msg;
-    std::shared_ptr<Exception> nested;
-    mutable std::string msgbuf; // temporarily used by what()
-  public:
-    Exception()
-      : showAddress(false)
-      , address(0)
-    {
-    }
-
-    Exception(std::uint64_t address, std::string msg)
-      : showAddress(true)
-      , address(address)
-      , msg(msg)
-    {
-    }
-
-    Exception(std::uint64_t address, std::string msg, const Exception &nested)
-      : showAddress(true)
-      , address(address)
-      , msg(msg)
-      , nested(std::make_shared<Exception>(nested))
-    {
-    }
-
-    Exception(std::string msg)
-      : showAddress(false)
-      , address(0)
-      , msg(msg)
-    {
-    }
-
-    Exception(std::string msg, const Exception &nested)
-      : showAddress(false)
-      , address(0)
-      , msg(msg)
-      , nested(std::make_shared<Exception>(nested))
-    {
-    }
-
-    virtual ~Exception() throw() {}
-
-    virtual const char *
-    what() const throw()
-    {
-	std::ostringstream os;
-	if (nested) {
-	    os << nested->what() << std::endl;
-	}
-	if (showAddress) {
-	    os << "[0x" << std::hex << std::setfill('0') << std::setw(16)
-	       << address << "] ";
-	}
-	os << msg;
-
-	msgbuf = os.str();
-	return msgbuf.c_str();
-    }
-};
+#include "hex-decode.hpp"
+#include "interner.hpp"
+#include "mapped-file.hpp"
+#include "output-buffer.hpp"
+#include "parallel-for.hpp"
+#include "parsed-object.hpp"
+#include "phase-stats.hpp"
+#include "text-scanner.hpp"
+#include "trace-events.hpp"
+#include "ulm-image.hpp"
 
 //------------------------------------------------------------------------------
 
@@ -96,10 +49,18 @@ alignAddr(T1 addr, T2 alignTo)
 
 struct Segment
 {
-    Segment()
+    /*
+	A segment with noBits set (BSS) has no contents, just a size. Labels
+	and marks are maintained as for other segments.
+    */
+    explicit Segment(bool noBits = false)
       : alignment(1)
       , baseAddr(0)
       , fill(0xFD)
+      , noBits(noBits)
+      , noBitsSize(0)
+      , strip(false)
+      , numPadding(0)
     {
     }
 
@@ -141,14 +102,16 @@ struct Segment
 	// after advanceTo(addr) the next byte will be appended at addr
 	assert(addr >= size());
 
-	std::size_t oldSize = size();
-
-	while (addr > size()) {
-	    appendByte(fill);
+	if (noBits) {
+	    noBitsSize = addr;
+	    return;
 	}
-
-	if (size() != oldSize) {
-	    appendAnnotation("      (ulmld: padding for alignment)");
+	if (addr > size()) {
+	    numPadding += addr - size();
+	    memory.resize(addr, fill);
+	    if (!strip) {
+		appendAnnotation("      (ulmld: padding for alignment)");
+	    }
 	}
 	assert(size() == addr);
     }
@@ -156,7 +119,8 @@ struct Segment
     void
     appendByte(unsigned char byte)
     {
-	memory[size()] = byte;
+	assert(!noBits);
+	memory.push_back(byte);
     }
 
     void
@@ -164,6 +128,11 @@ struct Segment
     {
 	addr -= baseAddr;
 
+	if (noBits || addr > size() || numBytes > size() - addr) {
+	    std::ostringstream os;
+	    os << "fix of " << numBytes << " bytes does not fit into segment";
+	    throw Exception(baseAddr + addr, os.str());
+	}
 	for (std::uint64_t i = numBytes; i-- > 0;) {
 	    unsigned char byte = value & 0xFF;
 	    value >>= 8;
@@ -171,38 +140,11 @@ struct Segment
 	}
     }
 
-    bool
-    requiresAdvanceTo(std::uint64_t addr)
-    {
-	return addr - baseAddr > size();
-    }
-
     void
-    insertByteString(std::uint64_t addr, std::string hexDigits)
+    appendBytes(const unsigned char *bytes, std::size_t numBytes)
     {
-	addr -= baseAddr;
-
-	if (requiresAdvanceTo(addr)) {
-	    advanceTo(addr);
-	}
-
-	std::size_t numBytes = hexDigits.length();
-	assert(numBytes % 2 == 0);
-	numBytes /= 2;
-
-	for (std::size_t i = 0; i < numBytes; ++i) {
-	    std::string byteString;
-	    int byte;
-
-	    byteString = hexDigits.substr(0, 2);
-	    hexDigits = hexDigits.substr(2);
-
-	    std::istringstream in(byteString);
-	    if (!(in >> std::hex >> byte)) {
-		std::cerr << "not in hex format or corrupted " << std::endl;
-	    }
-	    memory[addr + i] = byte & 0xFF;
-	}
+	assert(!noBits);
+	memory.insert(memory.end(), bytes, bytes + numBytes);
     }
 
     void
@@ -216,6 +158,9 @@ struct Segment
     void
     insertAnnotation(const std::string &text, std::size_t addr)
     {
+	if (noBits || strip) {
+	    return;
+	}
 	addr -= baseAddr;
 
 	if (annotation.count(addr)) {
@@ -227,79 +172,97 @@ struct Segment
     }
 
     void
-    insertLabel(const std::string &text, std::size_t addr)
+    insertLabel(std::string_view ident, std::size_t addr)
     {
-	label[addr - baseAddr].push_back(text);
+	if (strip) {
+	    return;
+	}
+	label[addr - baseAddr].push_back("#" + std::string(ident) + ":");
     }
 
     void
     appendHeader(const std::string &text)
     {
+	if (strip) {
+	    return;
+	}
 	header[size()].push_back(text);
     }
 
     std::uint64_t
     size() const
     {
-	return memory.size();
+	return noBits ? noBitsSize : memory.size();
     }
 
     void
-    print(std::ostream &out, bool strip = false) const
+    print(io::output_buffer &out, bool strip = false) const
     {
+	/* the maps are visited in ascending order of their keys */
+	auto nextAnnotation = annotation.begin();
+	auto nextHeader = header.begin();
+	auto nextLabel = label.begin();
+	auto at = [](auto &it, const auto &map, std::uint64_t i) {
+	    while (it != map.end() && it->first < i) {
+		++it;
+	    }
+	    return it != map.end() && it->first == i;
+	};
+	auto putLines = [&out](const std::vector<std::string> &lines) {
+	    for (auto &v : lines) {
+		out.put(v);
+		out.put('\n');
+	    }
+	};
+
 	for (std::uint64_t i = 0; i < size(); ++i) {
 	    if (!strip) {
-		if (header.count(i)) {
-		    for (auto &v : header.at(i)) {
-			out << v << std::endl;
-		    }
+		if (at(nextHeader, header, i)) {
+		    putLines(nextHeader->second);
 		}
-		if (label.count(i)) {
-		    for (auto &v : label.at(i)) {
-			out << v << std::endl;
-		    }
+		if (at(nextLabel, label, i)) {
+		    putLines(nextLabel->second);
 		}
-		out << "0x" << std::setw(16) << std::setfill('0') << std::hex
-		    << std::uppercase << (i + baseAddr) << ": ";
 		std::uint64_t addr = i + baseAddr;
+		out.put("0x");
+		out.put_hex(addr, 16);
+		out.put(": ");
 		if (addr % 4 != 0) {
-		    out << std::setw(3 * (addr % 4)) << std::setfill(' ')
-			<< " ";
+		    out.put_spaces(3 * (addr % 4));
 		}
 	    }
 	    // print remaining bytes till next annotation
 	    for (; i < size(); ++i) {
-		out << std::setw(2) << std::setfill('0') << std::hex
-		    << std::uppercase << int(memory.at(i))
-		    << (strip ? "" : " ");
+		out.put_hex_byte(memory[i]);
 		if (!strip) {
+		    out.put(' ');
 		    std::uint64_t addr = i + baseAddr;
-		    if (annotation.count(i)) {
+		    if (at(nextAnnotation, annotation, i)) {
 			if (addr % 4 != 3) {
-			    out << std::setw(3 * (3 - addr % 4))
-				<< std::setfill(' ') << " ";
+			    out.put_spaces(3 * (3 - addr % 4));
 			}
-			out << annotation.at(i) << std::endl;
+			out.put(nextAnnotation->second);
+			out.put('\n');
 			break;
 		    }
-		    if (header.count(i + 1) || label.count(i + 1)) {
-			out << std::endl;
+		    if (at(nextHeader, header, i + 1) ||
+			at(nextLabel, label, i + 1))
+		    {
+			out.put('\n');
 			break;
 		    }
 		    if (addr % 4 == 3) {
-			out << std::endl
-			    << std::setw(20) << std::setfill(' ') << " ";
+			out.put('\n');
+			out.put_spaces(20);
 		    }
 		}
 	    }
 	}
 	if (!annotation.count(size() - 1)) {
-	    out << std::endl;
+	    out.put('\n');
 	}
 	if (header.count(size())) {
-	    for (auto &v : header.at(size())) {
-		out << v << std::endl;
-	    }
+	    putLines(header.at(size()));
 	}
     }
 
@@ -319,365 +282,670 @@ struct Segment
 
     std::uint64_t alignment, baseAddr;
     unsigned char fill;
-    std::map<std::uint64_t, unsigned char> memory;
+    bool noBits;
+    std::uint64_t noBitsSize;
+    // segment contents, contiguous from baseAddr on
+    std::vector<unsigned char> memory;
     std::map<std::uint64_t, std::string> annotation;
     std::map<std::uint64_t, std::vector<std::string>> header, label;
     std::map<std::string, std::uint64_t> mark;
+    // no annotations, headers and labels are kept if set
+    bool strip;
+    // bytes inserted for alignment
+    std::uint64_t numPadding;
 };
 
-struct ObjectFile
+/*
+   Archives compiled into ulmld (see EMBED_LIBS in the Makefile). They are
+   preferred for -lname, i.e. libname.a is then not looked up in the file
+   system.
+*/
+struct EmbeddedLibrary
 {
-    static constexpr std::size_t numSegments = 3;
+    std::string_view name; // libname.a
+    std::string_view contents;
+};
 
-    ObjectFile()
-      : segments(numSegments)
+#include "embedded_libs.hpp"
+
+/*
+   Directories where -lname is looked up as libname.a: first those of the
+   -L options in the order of the command line, then those of
+   ULM_LIBRARY_PATH. Directory listings and lookup results are cached for
+   the whole run; directories which cannot be listed are probed with stat.
+*/
+class LibraryPath
+{
+  public:
+    void
+    add(const std::string &dir)
     {
-	if (std::getenv("ULM_LIBRARY_PATH")) {
-	    std::string libpath_env = std::getenv("ULM_LIBRARY_PATH");
+	if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+	    dirs.push_back(dir);
+	    results.clear();
+	}
+    }
 
-	    size_t pos = 0;
-	    std::string delim = ":";
-	    while ((pos = libpath_env.find(delim)) != std::string::npos) {
-		libpath.insert(libpath_env.substr(0, pos));
-		libpath_env.erase(0, pos + delim.length());
+    /* adds the directories of a colon separated list */
+    void
+    addList(std::string_view list)
+    {
+	for (;;) {
+	    std::size_t pos = list.find(':');
+	    add(std::string(list.substr(0, pos)));
+	    if (pos == std::string_view::npos) {
+		break;
 	    }
-	    libpath.insert(libpath_env);
+	    list.remove_prefix(pos + 1);
+	}
+    }
 
-	    /*
-	    std::cout << "--------" << std::endl;
-	    for (auto p : libpath) {
-		std::cout << p << std::endl;
+    /* paths of all candidates for -lname in search order */
+    const std::vector<std::string> &
+    find(const std::string &name)
+    {
+	auto it = results.find(name);
+	if (it != results.end()) {
+	    return it->second;
+	}
+	std::vector<std::string> &paths = results[name];
+	std::string filename = "lib" + name + ".a";
+	for (const auto &dir : dirs) {
+	    if (contains(dir, filename)) {
+		paths.push_back(dir + "/" + filename);
 	    }
-	    std::cout << "--------" << std::endl;
-	    */
 	}
+	return paths;
     }
 
-    using SymEntry = std::pair<char, std::uint64_t>;
+  private:
+    bool
+    contains(const std::string &dir, const std::string &filename)
+    {
+	auto it = listings.find(dir);
+	if (it == listings.end()) {
+	    it = listings.emplace(dir, readDir(dir)).first;
+	}
+	if (it->second) {
+	    return it->second->count(filename) > 0;
+	}
+	struct stat statbuf;
+	return ::stat((dir + "/" + filename).c_str(), &statbuf) == 0 &&
+	       S_ISREG(statbuf.st_mode);
+    }
 
-    struct FixEntry
+    static std::optional<std::unordered_set<std::string>>
+    readDir(const std::string &dir)
     {
-	FixEntry(std::string segment, std::uint64_t addr, std::uint64_t offset,
-		 std::uint64_t numBytes, std::string kind,
-		 std::int64_t displace)
-	  : segment(segment)
-	  , kind(kind)
-	  , addr(addr)
-	  , offset(offset)
-	  , numBytes(numBytes)
-	  , displace(displace)
-	{
+	DIR *dp = ::opendir(dir.c_str());
+	if (!dp) {
+	    return std::nullopt;
+	}
+	std::unordered_set<std::string> names;
+	while (struct dirent *entry = ::readdir(dp)) {
+	    names.insert(entry->d_name);
+	}
+	::closedir(dp);
+	return names;
+    }
+
+    std::vector<std::string> dirs;
+    // nullopt for directories that cannot be listed
+    std::unordered_map<std::string,
+		       std::optional<std::unordered_set<std::string>>>
+      listings;
+    std::unordered_map<std::string, std::vector<std::string>> results;
+};
+
+// timeline of --trace=FILE
+static trace::recorder tracer;
+
+struct ObjectFile
+{
+    static constexpr std::size_t numSegments = 3;
+
+    using SymbolId = intern::id_type;
+
+    // ids of the pseudo symbols for fixes relative to a segment
+    static constexpr SymbolId textId = 0, dataId = 1, bssId = 2;
+
+    ObjectFile()
+      : segments{ Segment(), Segment(), Segment(true) }
+    {
+	intern("[text]");
+	intern("[data]");
+	intern("[bss]");
+    }
+
+    /* no annotations, headers or labels are kept for a stripped output */
+    void
+    setStrip()
+    {
+	strip = true;
+	for (auto &segment : segments) {
+	    segment.strip = true;
 	}
+    }
+
+    using SymEntry = std::pair<char, std::uint64_t>;
 
-	std::string segment, kind;
-	std::uint64_t addr, offset, numBytes;
+    // addr is relative to the begin of segment seg (0=text, 1=data)
+    struct FixEntry
+    {
+	std::uint64_t addr;
 	std::int64_t displace;
+	SymbolId ident;
+	std::uint8_t seg;
+	FixKind kind;
+	std::uint8_t offset, numBytes;
     };
 
-    std::optional<std::string>
-    readSymtabIndex(std::istream &in)
+    SymbolId
+    intern(std::string_view ident)
     {
-	std::string line;
-	while (std::getline(in, line)) {
-	    char kind;
-	    std::string ident, member;
-
-	    std::istringstream(line) >> kind >> ident >> member;
-	    if (unresolved.count(ident)) {
-		return member;
-	    }
+	SymbolId id = symbols.intern(ident);
+	if (id >= symTab.size()) {
+	    symTab.resize(id + 1, SymEntry(0, 0));
+	    unresolved.resize(id + 1);
 	}
-	return std::nullopt;
+	return id;
+    }
+
+    bool
+    isDefined(SymbolId id) const
+    {
+	return symTab[id].first != 0;
     }
 
     /*
-	return value:
-	0  complete object file or all object files of a library were added.
-	1  one object file from a library was added to solve a unresolved
-       symbol.
+	An archive index lists for each symbol defined by a member that
+	member. Members are kept in the order of the index, the position of
+	the first entry of a symbol is found by the map first or, for the
+	binary index of ulmranlib_mkindex -b, by its hash table. In the
+	latter case there is one entry per member.
     */
+    using Member = ar::archive_reader::member;
 
-    int
-    addLibOrObject(std::string file, bool onlyLibs = false)
+    struct ArchiveIndex
     {
-	ar::archive_reader archive;
+	std::vector<const Member *> entries;
+	std::unordered_map<SymbolId, std::size_t> first;
+	arindex::table hashed;
 
-	bool success = false;
-	if (file.find("-l") == 0) {
-	    for (auto path : libpath) {
-		path = path + "/lib" + file.substr(2) + ".a";
-		if (archive.open(path.c_str())) {
-		    success = true;
-		    file = path;
-		    break;
-		}
-	    }
-	} else {
-	    if (archive.open(file.c_str())) {
-		success = true;
-	    }
+	void
+	add(SymbolId id, const Member *member)
+	{
+	    first.emplace(id, entries.size());
+	    entries.push_back(member);
 	}
-	if (!success && !onlyLibs) {
-	    std::ifstream in(file);
-	    if (!in) {
-		std::ostringstream os;
-		if (file.find("-l") == 0) {
-		    os << "can not find " << file;
-		} else {
-		    os << "can not open " << file;
-		}
-		throw Exception(os.str());
+
+	std::optional<std::size_t>
+	find(SymbolId id, std::string_view name) const
+	{
+	    if (hashed.is_open()) {
+		return hashed.find(name);
 	    }
-	    readSegments(in, file);
-	    return 0;
+	    auto it = first.find(id);
+	    if (it == first.end()) {
+		return std::nullopt;
+	    }
+	    return it->second;
 	}
+    };
 
-	int resolved = 0;
+    /*
+	The symbol table of the archive itself (as maintained by ranlib)
+	refers to members by their offsets and is preferred if it has any
+	entries.
+    */
+    bool
+    readSymbolTable(const ar::archive_reader &archive, ArchiveIndex &index)
+    {
+	bool ok = archive.for_each_symbol(
+	  [&](const char *symbol, const Member &member) {
+	      index.add(intern(symbol), &member);
+	  });
+	return ok && !index.entries.empty();
+    }
 
-	ar::archive_stream in(archive);
-	in.open("__SYMTAB_INDEX");
-	if (!in) {
-	    for (auto &member : archive) {
-		in.open(member.name);
-		std::string name = file + "(" + member.name + ")";
-		readSegments(in, name);
+    /*
+	The __SYMTAB_INDEX member created by ulmranlib_mkindex has one
+	"kind ident member" line per symbol.
+    */
+    ArchiveIndex
+    readArchiveIndex(const ar::archive_reader &archive, std::string_view text,
+		     const std::string &file)
+    {
+	ArchiveIndex index;
+	std::string_view line;
+	std::string_view lastName;
+	const Member *last = nullptr;
+	while (scan::next_line(text, line)) {
+	    scan::skip_space(line);
+	    if (line.empty() || line[0] == '#') {
+		continue;
 	    }
-	} else {
-	    while (1) {
-		if (auto member = readSymtabIndex(in)) {
-		    in.open(*member);
-		    std::string name = file + "(" + *member + ")";
-		    readSegments(in, name);
-		    resolved = 1;
-		    in.open("__SYMTAB_INDEX");
-		    continue;
+	    line.remove_prefix(1); // kind
+	    SymbolId id = intern(scan::next_token(line));
+	    std::string_view name = scan::next_token(line);
+	    /* the entries of a member are usually adjacent */
+	    if (!last || name != lastName) {
+		last = archive.find(name);
+		lastName = name;
+		if (!last) {
+		    std::ostringstream os;
+		    os << "index of " << file << " refers to missing member "
+		       << name;
+		    throw Exception(os.str());
 		}
-		break;
 	    }
+	    index.add(id, last);
 	}
-	return resolved;
+	return index;
     }
 
+    /*
+	The binary index refers to members by their offsets. As these are
+	stale if the archive was modified after the index was created,
+	members are looked up by name if name or size do not match.
+    */
     void
-    readSegments(std::istream &in, std::string source)
+    readBinaryIndex(const ar::archive_reader &archive, std::string_view data,
+		    const std::string &file, ArchiveIndex &index)
     {
-	std::string line, comment;
-	std::uint64_t addr, baseAddr = 0;
-	std::size_t seg = -1;
-
-	if (in.peek() != '#') {
+	if (!index.hashed.open(data)) {
 	    std::ostringstream os;
-	    os << "not an object file " << source;
+	    os << "corrupt index of " << file;
 	    throw Exception(os.str());
 	}
-
-	while (std::getline(in, line)) {
-	    if (line.find("#TEXT") == 0) {
-		seg = 0;
-		line = line.substr(5);
-		line.erase(std::remove_if(line.begin(), line.end(), isspace),
-			   line.end());
-		if (line.length() > 0) {
-		    std::uint64_t alignment;
-		    std::istringstream iss(line);
-		    std::istringstream(line) >> alignment;
-		    segments[seg].setAlignment(alignment);
-		}
-		segments[seg].setMark(source);
-		continue;
+	for (std::uint32_t m = 0; m < index.hashed.size(); ++m) {
+	    std::string_view name = index.hashed.member_name(m);
+	    auto member = archive.member_at(index.hashed.member_offset(m));
+	    if (!member || member->name != name ||
+		member->size != index.hashed.member_size_of(m))
+	    {
+		member = archive.find(name);
 	    }
-	    if (line.find("#DATA") == 0) {
-		seg = 1;
-		line = line.substr(5);
-		line.erase(std::remove_if(line.begin(), line.end(), isspace),
-			   line.end());
-		if (line.length() > 0) {
-		    std::uint64_t alignment;
-		    std::istringstream(line) >> alignment;
-		    segments[seg].setAlignment(alignment);
-		}
-		segments[seg].setMark(source);
-		continue;
+	    if (!member) {
+		std::ostringstream os;
+		os << "index of " << file << " refers to missing member "
+		   << name;
+		throw Exception(os.str());
 	    }
-	    if (line.find("#BSS") == 0) {
-		seg = 2;
-		segments[seg].setMark(source);
-		line = line.substr(4);
-		assert(line.length());
+	    index.entries.push_back(member);
+	}
+    }
 
-		std::uint64_t alignment, size;
-		std::istringstream(line) >> std::dec >> alignment >> size;
+    /*
+	Positions of index entries, together with the unresolved symbol they
+	were found for, which are to be looked up in an archive, smallest
+	position first.
+    */
+    struct PendingArchive
+    {
+	using Entry = std::pair<std::size_t, SymbolId>;
 
-		segments[seg].setAlignment(alignment);
-		if (size) {
-		    size += segments[seg].getMark(source);
-		    segments[seg].advanceTo(size);
-		}
-		continue;
-	    }
-	    if (line.find("#SYMTAB") == 0) {
-		seg = 3;
-		continue;
-	    }
-	    if (line.find("#FIXUPS") == 0) {
-		seg = 4;
-		continue;
+	const ArchiveIndex *index;
+	const std::string *file;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>
+	  pending;
+
+	void
+	lookup(SymbolId id, std::string_view name)
+	{
+	    if (auto pos = index->find(id, name)) {
+		pending.push({ *pos, id });
 	    }
-	    if (line.find("#") == 0 || line.length() == 0) {
-		continue;
+	}
+    };
+
+    /*
+	Loads members of the given archives as long as their indexes provide
+	a definition for an unresolved symbol. The archives are taken in turn
+	and members are loaded from an archive in the same order as if its
+	index was scanned for the first entry of an unresolved symbol after
+	each loaded member. This is repeated until no archive resolves
+	anything, i.e. like passes over a group of archives. But no index is
+	scanned, each unresolved symbol is looked up once per archive, later
+	just the symbols that became unresolved by loading a member.
+    */
+    void
+    resolveFromArchives(std::vector<PendingArchive> &archives)
+    {
+	trace::span lookupSpan(tracer, "index lookup", "resolve");
+	for (SymbolId id = 0; id < unresolved.size(); ++id) {
+	    if (unresolved[id]) {
+		for (auto &archive : archives) {
+		    archive.lookup(id, symbols.name(id));
+		}
 	    }
-	    // reading text or data segement
-	    if (seg == 0 || seg == 1) {
-		// extract comment (if any)
-		std::size_t comment_index = line.find("#");
-		if (comment_index != std::string::npos) {
-		    ++comment_index; // skip '#'
-		    if (line[comment_index] == ' ') {
-			++comment_index;
+	}
+	lookupSpan.end();
+
+	for (bool done = false; !done;) {
+	    trace::span roundSpan(tracer, "resolve round", "resolve");
+	    done = true;
+	    for (auto &archive : archives) {
+		if (archive.pending.empty()) {
+		    continue;
+		}
+		trace::span span(tracer, "resolve", "resolve", *archive.file);
+		while (!archive.pending.empty()) {
+		    done = false;
+		    auto [pos, id] = archive.pending.top();
+		    archive.pending.pop();
+		    if (!unresolved[id]) {
+			continue;
+		    }
+		    loadMember(*archive.index->entries[pos], *archive.file);
+		    for (SymbolId newId : newlyUnresolved) {
+			for (auto &other : archives) {
+			    other.lookup(newId, symbols.name(newId));
+			}
 		    }
-		    comment = line.substr(comment_index);
-		} else {
-		    comment = "";
 		}
+	    }
+	}
+    }
 
-		// remove comment and spaces
-		line.erase(std::find(line.begin(), line.end(), '#'),
-			   line.end());
-		line.erase(std::remove_if(line.begin(), line.end(), isspace),
-			   line.end());
+    void
+    loadMember(const Member &member, const std::string &file)
+    {
+	++numMembers;
+	std::string name = file + "(" + std::string(member.name) + ")";
+	readSegments(std::string_view(member.data(), member.size), name);
+    }
 
-		if (segments[seg].isAtMark(source)) {
-		    segments[seg].appendHeader("# from: " + source);
-		}
+    /* returns false if the archive has no kind of index */
+    bool
+    readIndex(const ar::archive_reader &archive, const std::string &file,
+	      ArchiveIndex &index)
+    {
+	if (readSymbolTable(archive, index)) {
+	    return true;
+	}
+	if (auto indexMember = archive.find("__SYMTAB_INDEX")) {
+	    std::string_view data(indexMember->data(), indexMember->size);
+	    if (arindex::is_index(data)) {
+		readBinaryIndex(archive, data, file, index);
+	    } else {
+		index = readArchiveIndex(archive, data, file);
+	    }
+	    return true;
+	}
+	return false;
+    }
 
-		// extract address (if any)
-		if (line.find(":") != std::string::npos) {
-		    std::istringstream(line) >> std::hex >> addr;
-		    line = line.substr(line.find(":") + 1);
+    /*
+	Archives are opened, scanned and indexed just once per run even if
+	they are named repeatedly, in groups or under different paths. The
+	cache is keyed by device and inode; an archive is opened again only
+	if its modification time or size changed in the meantime.
+    */
+    struct CachedArchive
+    {
+	ar::archive_reader archive;
+	bool hasIndex = false;
+	ArchiveIndex index;
+	struct timespec mtime;
+	off_t size;
+    };
 
-		    if (segments[seg].isAtMark(source)) {
-			baseAddr = addr;
-		    }
-		    addr -= baseAddr;
-		} else {
-		    addr = segments[seg].size() - segments[seg].getMark(source);
-		    if (segments[seg].isAtMark(source)) {
-			baseAddr = addr;
-		    }
-		}
+    /* returns nullptr if path does not name an archive */
+    const CachedArchive *
+    lookupArchive(const std::string &path)
+    {
+	struct stat statbuf;
+	if (::stat(path.c_str(), &statbuf) < 0 || !S_ISREG(statbuf.st_mode)) {
+	    return nullptr;
+	}
+	auto &cached = archiveCache[{ statbuf.st_dev, statbuf.st_ino }];
+	if (cached && cached->size == statbuf.st_size &&
+	    cached->mtime.tv_sec == statbuf.st_mtim.tv_sec &&
+	    cached->mtime.tv_nsec == statbuf.st_mtim.tv_nsec)
+	{
+	    return cached->archive.is_open() ? cached.get() : nullptr;
+	}
+	trace::span span(tracer, "open archive", "archive", path);
+	cached = std::make_unique<CachedArchive>();
+	cached->mtime = statbuf.st_mtim;
+	cached->size = statbuf.st_size;
+	if (!cached->archive.open(path.c_str())) {
+	    /* remembered as not being an archive */
+	    return nullptr;
+	}
+	cached->hasIndex = readIndex(cached->archive, path, cached->index);
+	return cached.get();
+    }
 
-		addr += segments[seg].getMark(source);
-		if (segments[seg].requiresAdvanceTo(addr)) {
+    /* returns nullptr if there is no embedded archive with this name */
+    const CachedArchive *
+    lookupEmbedded(const std::string &name)
+    {
+	for (const auto &lib : embeddedLibraries) {
+	    if (lib.name != name) {
+		continue;
+	    }
+	    auto &cached = embeddedCache[name];
+	    if (!cached) {
+		trace::span span(tracer, "open archive", "archive", lib.name);
+		cached = std::make_unique<CachedArchive>();
+		if (!cached->archive.open(lib.contents.data(),
+					  lib.contents.size()))
+		{
 		    std::ostringstream os;
-		    os << "In segment '" << seg
-		       << "' (0=text, 1=data, "
-			  "2=bss) there is a gap that would require "
-			  "fillin bytes. That's only allowed for "
-			  "alignment";
+		    os << "embedded archive " << name << " is corrupt";
 		    throw Exception(os.str());
 		}
-		segments[seg].insertByteString(addr, line);
-		if (comment.length()) {
-		    segments[seg].appendAnnotation(comment);
-		}
-		continue;
+		cached->hasIndex =
+		  readIndex(cached->archive, "embedded:" + name, cached->index);
 	    }
-	    // reading symtab
-	    if (seg == 3) {
-		char kind;
-		std::string ident;
-		std::uint64_t value;
-
-		std::istringstream(line) >> kind >> ident >> std::hex >> value;
+	    return cached.get();
+	}
+	return nullptr;
+    }
 
-		switch (kind) {
-		    case 'T':
-			unresolved.erase(ident);
-		    case 't':
-			value += segments[0].getMark(source);
-			segments[0].insertLabel("#" + ident + ":", value);
-			break;
-		    case 'D':
-			unresolved.erase(ident);
-		    case 'd':
-			value += segments[1].getMark(source);
-			segments[1].insertLabel("#" + ident + ":", value);
-			break;
-		    case 'B':
-			unresolved.erase(ident);
-		    case 'b':
-			value += segments[2].getMark(source);
-			segments[2].insertLabel("#" + ident + ":", value);
-			break;
-		}
-		if (kind == 'U') {
-		    if (!symTab.count(ident) || !isupper(symTab[ident].first)) {
-			unresolved.insert(ident);
-		    }
-		    continue;
+    /*
+	Opens file as archive where -lname is looked up among the embedded
+	archives and then in the library path. In this case file is replaced
+	by the path of the archive found, "embedded:libname.a" for an
+	embedded one.
+    */
+    const CachedArchive *
+    openArchive(std::string &file)
+    {
+	if (file.find("-l") == 0) {
+	    std::string name = "lib" + file.substr(2) + ".a";
+	    if (auto archive = lookupEmbedded(name)) {
+		file = "embedded:" + name;
+		return archive;
+	    }
+	    for (const auto &path : libpath.find(file.substr(2))) {
+		if (auto archive = lookupArchive(path)) {
+		    file = path;
+		    return archive;
 		}
+	    }
+	    return nullptr;
+	}
+	return lookupArchive(file);
+    }
 
-		if (ident[0] == '.') {
-		    continue;
-		}
-		if (std::toupper(kind) != kind) {
-		    localSymTab[ident].push_back({ kind, value });
-		    continue;
-		}
-		if (symTab.count(ident)) {
-		    std::ostringstream os;
-		    os << " multiple definition of `" << ident;
-		    throw Exception(os.str());
+    void
+    addLibOrObject(std::string file)
+    {
+	auto archive = openArchive(file);
+	if (!archive) {
+	    io::mapped_file in;
+	    if (file.find("-l") == 0 || !in.open(file.c_str())) {
+		std::ostringstream os;
+		if (file.find("-l") == 0) {
+		    os << "can not find " << file;
+		} else {
+		    os << "can not open " << file;
 		}
-		symTab[ident] = { kind, value };
-		continue;
+		throw Exception(os.str());
 	    }
-	    // reading fixables
-	    if (seg == 4) {
-		std::string segment, kind, ident;
-		std::uint64_t address, offset, numBytes;
+	    ++numFiles;
+	    readSegments(in.contents(), file);
+	    return;
+	}
+
+	if (archive->hasIndex) {
+	    std::vector<PendingArchive> archives(1);
+	    archives[0].index = &archive->index;
+	    archives[0].file = &file;
+	    resolveFromArchives(archives);
+	} else {
+	    for (auto &member : archive->archive) {
+		loadMember(member, file);
+	    }
+	}
+    }
+
+    /*
+	Resolves symbols from the archives of a group, each of them was
+	already added by addLibOrObject. Other files and archives without
+	an index (whose members were all added) are skipped.
+    */
+    void
+    resolveFromGroup(std::vector<std::string> files)
+    {
+	std::vector<PendingArchive> archives;
+	for (auto &file : files) {
+	    auto archive = openArchive(file);
+	    if (archive && archive->hasIndex) {
+		archives.emplace_back();
+		archives.back().index = &archive->index;
+		archives.back().file = &file;
+	    }
+	}
+	resolveFromArchives(archives);
+    }
 
-		std::istringstream(line) >> segment >> std::hex >> address >>
-		  std::dec >> offset >> numBytes >> kind >> ident;
+    void
+    readSegments(std::string_view text, const std::string &source)
+    {
+	trace::span span(tracer, "parse", "parse", source);
+	ParsedObject object;
+	object.read(text, source, strip);
+	addObject(object);
+    }
 
-		// hack to support ulmas for ulm-generator
-		assert(offset % 8 == 0);
-		assert(numBytes % 4 == 0);
-		offset /= 8;
-		numBytes /= 8;
+    void
+    addObject(const ParsedObject &object)
+    {
+	const std::string &source = object.source;
 
-		std::size_t fixInSeg = segment == "text" ? 0 : 1;
-		std::int64_t displace = 0;
+	newlyUnresolved.clear();
+	numLines += object.numLines;
+	numSymbols += object.symbols.size();
+	for (std::size_t i = 0; i < object.numCorrupted; ++i) {
+	    std::cerr << "not in hex format or corrupted " << std::endl;
+	}
 
-		address += segments[fixInSeg].getMark(source);
+	for (std::size_t seg = 0; seg < 2; ++seg) {
+	    const ParsedObject::Section &section = object.sections[seg];
+	    if (!section.present) {
+		continue;
+	    }
+	    if (section.alignment) {
+		segments[seg].setAlignment(section.alignment);
+	    }
+	    segments[seg].setMark(source);
+	    for (std::size_t i = 0; i < section.numHeaders; ++i) {
+		segments[seg].appendHeader("# from: " + source);
+	    }
+	    segments[seg].appendBytes(section.data(), section.size());
+	    if (!section.mapped) {
+		numDecoded += section.size();
+	    }
+	    std::uint64_t mark = segments[seg].getMark(source);
+	    for (auto &[size, comment] : section.annotations) {
+		std::uint64_t addr = mark + size > 0 ? mark + size - 1 : 0;
+		segments[seg].insertAnnotation(std::string(comment), addr);
+	    }
+	}
+	if (object.hasBss) {
+	    segments[2].setAlignment(object.bssAlignment);
+	    segments[2].setMark(source);
+	    if (object.bssSize) {
+		segments[2].advanceTo(object.bssSize +
+				      segments[2].getMark(source));
+	    }
+	}
 
-		if (std::size_t p = ident.find("+"); p != std::string::npos) {
-		    std::istringstream(ident.substr(p)) >> displace;
-		    ident = ident.substr(0, p);
-		} else if (std::size_t p = ident.find("-");
-			   p != std::string::npos) {
-		    std::istringstream(ident.substr(p)) >> displace;
-		    ident = ident.substr(0, p);
+	for (auto &sym : object.symbols) {
+	    char kind = sym.kind;
+	    std::string_view ident = sym.ident;
+	    SymbolId id = intern(ident);
+	    std::uint64_t value = sym.value;
+
+	    switch (kind) {
+		case 'T':
+		    unresolved[id] = false;
+		    [[fallthrough]];
+		case 't':
+		    value += segments[0].getMark(source);
+		    segments[0].insertLabel(ident, value);
+		    break;
+		case 'D':
+		    unresolved[id] = false;
+		    [[fallthrough]];
+		case 'd':
+		    value += segments[1].getMark(source);
+		    segments[1].insertLabel(ident, value);
+		    break;
+		case 'B':
+		    unresolved[id] = false;
+		    [[fallthrough]];
+		case 'b':
+		    value += segments[2].getMark(source);
+		    segments[2].insertLabel(ident, value);
+		    break;
+	    }
+	    if (kind == 'U') {
+		if (!unresolved[id] &&
+		    (!isDefined(id) || !isupper(symTab[id].first)))
+		{
+		    unresolved[id] = true;
+		    newlyUnresolved.push_back(id);
 		}
+		continue;
+	    }
 
-		if (ident == "[text]") {
-		    displace += segments[0].getMark(source);
-		} else if (ident == "[data]") {
-		    displace += segments[1].getMark(source);
-		} else if (ident == "[bss]") {
-		    displace += segments[2].getMark(source);
-		}
+	    if (scan::starts_with(ident, ".")) {
+		continue;
+	    }
+	    if (std::toupper(kind) != kind) {
+		localSymTab.push_back({ id, { kind, value } });
+		continue;
+	    }
+	    if (isDefined(id)) {
+		std::ostringstream os;
+		os << " multiple definition of `" << ident;
+		throw Exception(os.str());
+	    }
+	    symTab[id] = { kind, value };
+	}
 
-		fixables[ident].push_back(
-		  FixEntry(segment, address, offset, numBytes, kind, displace));
+	for (auto &fix : object.fixups) {
+	    SymbolId id = intern(fix.ident);
+	    std::uint64_t addr = fix.addr + segments[fix.seg].getMark(source);
+	    std::int64_t displace = fix.displace;
 
-		continue;
+	    // fixes relative to segments of this object file
+	    if (id <= bssId) {
+		displace += segments[id].getMark(source);
 	    }
+
+	    fixables.push_back({ addr, displace, id, fix.seg, fix.kind,
+				 fix.offset, fix.numBytes });
 	}
     }
 
     void
-    printSegment(std::ostream &out, int seg, bool printAddr = true) const
+    printSegment(io::output_buffer &out, int seg, bool printAddr = true) const
     {
 	if (segments[seg].size()) {
 	    segments[seg].print(out, printAddr);
@@ -685,45 +953,137 @@ struct ObjectFile
     }
 
     void
-    print(std::ostream &out, const std::string &ulm, bool strip = false) const
+    printSymbol(io::output_buffer &out, SymbolId id, const SymEntry &e) const
     {
-	out << "#!/usr/bin/env -S " << ulm << std::endl;
-	out << "#TEXT " << std::dec << segments[0].alignment << std::endl;
+	std::string_view name = symbols.name(id);
+	out.put(e.first);
+	out.put(' ');
+	out.put(name);
+	if (name.size() < 27) {
+	    out.put_spaces(27 - name.size());
+	}
+	out.put(" 0x");
+	out.put_hex(e.second, 16);
+	out.put('\n');
+    }
+
+    void
+    print(io::output_buffer &out, const std::string &ulm,
+	  bool strip = false) const
+    {
+	out.put("#!/usr/bin/env -S ");
+	out.put(ulm);
+	out.put("\n#TEXT ");
+	out.put_dec(segments[0].alignment);
+	out.put('\n');
 	printSegment(out, 0, strip);
-	out << "#DATA " << std::dec << segments[1].alignment << std::endl;
+	out.put("#DATA ");
+	out.put_dec(segments[1].alignment);
+	out.put('\n');
 	printSegment(out, 1, strip);
-	out << "#BSS " << segments[2].alignment << " " << std::dec
-	    << segments[2].size() << std::endl
-	    << "#(begins at 0x" << std::hex << segments[2].baseAddr << ")"
-	    << std::endl;
+	/* the alignment of the BSS segment has always been printed in hex
+	   if the data segment is not empty */
+	out.put("#BSS ");
+	if (segments[1].size()) {
+	    out.put_hex(segments[2].alignment);
+	} else {
+	    out.put_dec(segments[2].alignment);
+	}
+	out.put(' ');
+	out.put_dec(segments[2].size());
+	out.put("\n#(begins at 0x");
+	out.put_hex(segments[2].baseAddr);
+	out.put(")\n");
+
+	out.put("#SYMTAB \n");
+	for (SymbolId id : sortedByName(definedSymbols())) {
+	    printSymbol(out, id, symTab[id]);
+	}
+	for (auto &[id, e] : sortedLocals()) {
+	    printSymbol(out, id, e);
+	}
+    }
 
-	out << "#SYMTAB " << std::endl;
-	for (auto &[k, e] : symTab) {
-	    out << e.first << " " << std::left << std::setw(27)
-		<< std::setfill(' ') << k << " 0x" << std::right
-		<< std::setw(16) << std::setfill('0') << std::hex
-		<< std::uppercase << e.second << std::endl;
+    /* binary image with the same symbol table, see ulm-image.hpp */
+    void
+    writeImage(io::output_buffer &out, const std::string &ulm) const
+    {
+	image::contents img;
+	img.interpreter = ulm;
+	img.entry = segments[0].baseAddr;
+	image::segment *imageSegments[] = { &img.text, &img.data, &img.bss };
+	for (std::size_t seg = 0; seg < numSegments; ++seg) {
+	    const Segment &segment = segments[seg];
+	    imageSegments[seg]->base = segment.baseAddr;
+	    imageSegments[seg]->size = segment.size();
+	    imageSegments[seg]->alignment = segment.alignment;
+	    imageSegments[seg]->bytes = std::string_view(
+	      reinterpret_cast<const char *>(segment.memory.data()),
+	      segment.memory.size());
 	}
-	for (auto &[k, v] : localSymTab) {
-	    for (auto &e : v) {
-		out << e.first << " " << std::left << std::setw(27)
-		    << std::setfill(' ') << k << " 0x" << std::right
-		    << std::setw(16) << std::setfill('0') << std::hex
-		    << std::uppercase << e.second << std::endl;
+	img.with_symbols = !strip;
+	if (!strip) {
+	    for (SymbolId id : sortedByName(definedSymbols())) {
+		img.symbols.push_back(
+		  { symTab[id].first, symbols.name(id), symTab[id].second });
+	    }
+	    for (auto &[id, e] : sortedLocals()) {
+		img.symbols.push_back({ e.first, symbols.name(id), e.second });
 	    }
 	}
+	image::write(out, img);
+    }
+
+    std::vector<SymbolId>
+    definedSymbols() const
+    {
+	std::vector<SymbolId> ids;
+	for (SymbolId id = 0; id < symTab.size(); ++id) {
+	    if (isDefined(id)) {
+		ids.push_back(id);
+	    }
+	}
+	return ids;
+    }
+
+    std::vector<SymbolId>
+    sortedByName(std::vector<SymbolId> ids) const
+    {
+	std::sort(ids.begin(), ids.end(), [this](SymbolId a, SymbolId b) {
+	    return symbols.name(a) < symbols.name(b);
+	});
+	return ids;
+    }
+
+    std::vector<std::pair<SymbolId, SymEntry>>
+    sortedLocals() const
+    {
+	auto locals = localSymTab;
+	std::stable_sort(locals.begin(), locals.end(),
+			 [this](const auto &a, const auto &b) {
+			     return symbols.name(a.first) <
+				    symbols.name(b.first);
+			 });
+	return locals;
     }
 
     void
     dumpUnresolved()
     {
-	for (auto &ident : unresolved) {
-	    std::cout << ident << std::endl;
+	std::vector<SymbolId> ids;
+	for (SymbolId id = 0; id < unresolved.size(); ++id) {
+	    if (unresolved[id]) {
+		ids.push_back(id);
+	    }
+	}
+	for (SymbolId id : sortedByName(ids)) {
+	    std::cout << symbols.name(id) << std::endl;
 	}
     }
 
+    /* places the segments and relocates the symbol table */
     void
-    link()
+    layout()
     {
 	auto textAddr = segments[0].baseAddr;
 
@@ -746,8 +1106,10 @@ struct ObjectFile
 	// std::cerr << "bssAddr = " << bssAddr << std::endl;
 
 	// update in symtap relative addresses
-	for (auto &[ident, e] : symTab) {
-	    if (e.first == 'T') {
+	for (auto &e : symTab) {
+	    if (e.first == 0) {
+		continue; // not defined
+	    } else if (e.first == 'T') {
 		e.second += textAddr;
 	    } else if (e.first == 'D') {
 		e.second += dataAddr;
@@ -760,80 +1122,90 @@ struct ObjectFile
 		throw Exception(os.str());
 	    }
 	}
+    }
 
-	// resolve fixables
-	for (auto &[ident, vFixEntry] : fixables) {
-	    for (auto &fixEntry : vFixEntry) {
-		std::uint64_t addr = fixEntry.addr;
-		std::size_t seg;
-
-		if (fixEntry.segment == "text") {
-		    addr += textAddr;
-		    seg = 0;
-		} else if (fixEntry.segment == "data") {
-		    addr += dataAddr;
-		    seg = 1;
-		} else {
-		    std::ostringstream os;
-		    os << "Can't apply a fix in segment " << fixEntry.segment;
-		    throw Exception(os.str());
-		}
-
-		std::uint64_t value = fixEntry.displace;
-
-		if (ident == "[text]") {
-		    value += textAddr;
-		} else if (ident == "[data]") {
-		    value += dataAddr;
-		} else if (ident == "[bss]") {
-		    value += bssAddr;
-		} else if (symTab.count(ident)) {
-		    value += symTab[ident].second;
-		} else {
-		    std::ostringstream os;
-		    os << "Unresolved symbol " << ident;
-		    throw Exception(os.str());
-		}
+    /* patches the segments after layout() */
+    void
+    applyFixups()
+    {
+	const std::uint64_t segAddr[] = { segments[0].baseAddr,
+					  segments[1].baseAddr,
+					  segments[2].baseAddr };
+	for (const FixEntry &fix : fixables) {
+	    std::uint64_t addr = fix.addr + segAddr[fix.seg];
+	    std::uint64_t value = fix.displace;
+
+	    if (fix.ident <= bssId) {
+		value += segAddr[fix.ident];
+	    } else if (isDefined(fix.ident)) {
+		value += symTab[fix.ident].second;
+	    } else {
+		std::ostringstream os;
+		os << "Unresolved symbol " << symbols.name(fix.ident);
+		throw Exception(os.str());
+	    }
 
-		if (fixEntry.kind == "relative") {
+	    switch (fix.kind) {
+		case FixKind::Absolute:
+		    break;
+		case FixKind::Relative:
 		    if ((value - addr) % 4 != 0) {
 			std::ostringstream os;
 			os << "address for relative jump is not a multiple of "
 			      "4 ";
 			throw Exception(os.str());
 		    }
-
 		    value = (value - addr) / 4;
-		} else if (fixEntry.kind == "w0") {
-		    value = value & 0xFFFF;
-		} else if (fixEntry.kind == "w1") {
-		    value = value >> 16 & 0xFFFF;
-		} else if (fixEntry.kind == "w2") {
-		    value = value >> 32 & 0xFFFF;
-		} else if (fixEntry.kind == "w3") {
-		    value = value >> 48 & 0xFFFF;
-		} else if (fixEntry.kind != "absolute") {
-		    std::ostringstream os;
-		    os << "Can not apply a '" << fixEntry.kind << "' fix.";
-		    throw Exception(os.str());
-		}
-
-		segments[seg].patchBytes(addr + fixEntry.offset,
-					 fixEntry.numBytes, value);
+		    break;
+		default:
+		    // w0 to w3
+		    value >>= 16 * (std::uint8_t(fix.kind) -
+				    std::uint8_t(FixKind::W0));
+		    value &= 0xFFFF;
+		    break;
 	    }
+
+	    segments[fix.seg].patchBytes(addr + fix.offset, fix.numBytes,
+					 value);
 	}
     }
 
-    std::vector<Segment> segments;
-    std::map<std::string, SymEntry> symTab;
-    std::map<std::string, std::vector<SymEntry>> localSymTab;
-    std::set<std::string> unresolved;
-    std::map<std::string, std::vector<FixEntry>> fixables;
-    std::set<std::string> libpath;
+    void
+    addCounts(stats::report &report) const
+    {
+	std::uint64_t numPadding = 0;
+	for (const auto &segment : segments) {
+	    numPadding += segment.numPadding;
+	}
+	report.count("files", numFiles);
+	report.count("archive_members", numMembers);
+	report.count("lines", numLines);
+	report.count("bytes_decoded", numDecoded);
+	report.count("symbols", numSymbols);
+	report.count("fixups", fixables.size());
+	report.count("padding_bytes", numPadding);
+    }
 
-    /*
-	ident -> [ { segment, addr, offset, num, kind, displace } ]
-    */
+    std::vector<Segment> segments;
+    intern::interner symbols;
+    // indexed by SymbolId, entries of symbols not defined have kind 0
+    std::vector<SymEntry> symTab;
+    std::vector<std::pair<SymbolId, SymEntry>> localSymTab;
+    std::vector<bool> unresolved;
+    // symbols that became unresolved by the last added object
+    std::vector<SymbolId> newlyUnresolved;
+    std::vector<FixEntry> fixables;
+    LibraryPath libpath;
+    bool strip = false;
+    // counts for --stats: object files named on the command line, archive
+    // members, lines of textual objects, bytes decoded from hex digits and
+    // symbol table entries
+    std::uint64_t numFiles = 0, numMembers = 0, numLines = 0, numDecoded = 0,
+		  numSymbols = 0;
+    // also remembers files that are not archives
+    std::map<std::pair<dev_t, ino_t>, std::unique_ptr<CachedArchive>>
+      archiveCache;
+    std::map<std::string, std::unique_ptr<CachedArchive>> embeddedCache;
 };
 
 static std::vector<std::string> executables;
@@ -846,21 +1218,86 @@ delete_executable()
     }
 }
 
-std::unique_ptr<std::ofstream>
+int
 open_executable(const char *filename)
 {
     int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0777);
-    if (!fd) {
-	std::cerr << "cannot create '%s'" << filename << std::endl;
+    if (fd < 0) {
+	std::cerr << "cannot create '" << filename << "'" << std::endl;
 	std::exit(1);
     }
-    close(fd);
     executables.push_back(filename);
-    return std::make_unique<std::ofstream>(filename);
+    return fd;
+}
+
+/*
+    Explicit object files neither depend on each other nor on the state of
+    the link while they are read. Hence all command line arguments that
+    might name an object file are read in parallel in advance and added
+    later in command line order. Arguments that turn out to be archives or
+    that cannot be opened are left to addLibOrObject. Errors are kept
+    until the corresponding argument is reached such that they are reported
+    as by a serial link.
+*/
+
+struct PreloadedObject
+{
+    std::unique_ptr<ParsedObject> object;
+    std::exception_ptr error;
+};
+
+std::vector<PreloadedObject>
+preloadObjects(int argc, char **argv, unsigned numThreads, bool strip)
+{
+    std::vector<int> candidates;
+    for (int i = 0; i < argc; ++i) {
+	if (!strcmp("-o", argv[i]) || !strcmp("-L", argv[i])) {
+	    ++i;
+	    continue;
+	}
+	if (argv[i][0] != '-') {
+	    candidates.push_back(i);
+	}
+    }
+
+    std::vector<PreloadedObject> preloaded(argc);
+    par::parallel_for(candidates.size(), numThreads, [&](std::size_t k) {
+	int i = candidates[k];
+	try {
+	    auto object = std::make_unique<ParsedObject>();
+	    if (!object->mapping.open(argv[i])) {
+		return;
+	    }
+	    std::string_view text = object->mapping.contents();
+	    if (scan::starts_with(text, std::string_view(ARMAG, SARMAG))) {
+		return;
+	    }
+	    trace::span span(tracer, "parse", "parse", argv[i]);
+	    object->read(text, argv[i], strip);
+	    preloaded[i].object = std::move(object);
+	} catch (...) {
+	    preloaded[i].error = std::current_exception();
+	}
+    });
+    return preloaded;
 }
 
 static const char *cmdname;
 
+/* the trace of a failed link is written, too */
+void
+writeTrace(const std::string &traceFile)
+{
+    if (traceFile.empty()) {
+	return;
+    }
+    std::ofstream out(traceFile);
+    tracer.write_json(out);
+    if (!out.flush()) {
+	std::cerr << cmdname << ": can not write " << traceFile << std::endl;
+    }
+}
+
 void
 usage()
 {
@@ -871,10 +1308,28 @@ usage()
 int
 main(int argc, char **argv)
 {
-    std::unique_ptr<std::ostream> pOut;
+    int outFd = -1;
+    bool imageOutput = false;
     std::vector<std::string> inFile;
     std::uint64_t startAddr = 0;
+    unsigned numThreads = par::default_concurrency();
     ObjectFile objectFile;
+    stats::report report;
+    bool withStats = false;
+    std::string statsFile; // empty for std::cerr
+    std::string traceFile;
+    std::optional<trace::span> phaseSpan;
+    auto phase = [&](const char *name) {
+	report.phase(name);
+	phaseSpan.reset();
+	phaseSpan.emplace(tracer, name, "phase");
+    };
+    /* keeps the trace but no incomplete executable of a failed link */
+    auto abortLink = [&]() {
+	phaseSpan.reset();
+	writeTrace(traceFile);
+	delete_executable();
+    };
 
     cmdname = *argv++;
     --argc;
@@ -883,28 +1338,72 @@ main(int argc, char **argv)
 	usage();
     }
 
+    for (int i = 0; i < argc; ++i) {
+	if (!strncmp("--trace=", argv[i], 8)) {
+	    traceFile = argv[i] + 8;
+	    tracer.enable();
+	} else if (!strcmp("--counters", argv[i])) {
+	    withStats = true;
+	    report.enable_counters();
+	}
+    }
+    phase("startup");
+
+    /* options that must be known before any object is read */
+    for (int i = 0; i < argc; ++i) {
+	if (!strcmp("-o", argv[i])) {
+	    ++i;
+	    continue;
+	}
+	if (!strcmp("-s", argv[i])) {
+	    objectFile.setStrip();
+	    continue;
+	}
+	if (!strcmp("-L", argv[i])) {
+	    if (++i >= argc) {
+		usage();
+	    }
+	    objectFile.libpath.add(argv[i]);
+	    continue;
+	}
+	if (!strncmp("-L", argv[i], 2)) {
+	    objectFile.libpath.add(argv[i] + 2);
+	    continue;
+	}
+	if (!strncmp("--threads=", argv[i], 10)) {
+	    numThreads = std::max(std::atoi(argv[i] + 10), 1);
+	    continue;
+	}
+	if (!strcmp("--stats", argv[i]) || !strncmp("--stats=", argv[i], 8)) {
+	    withStats = true;
+	    statsFile = argv[i][7] ? argv[i] + 8 : "";
+	    continue;
+	}
+    }
+    if (const char *path = std::getenv("ULM_LIBRARY_PATH")) {
+	objectFile.libpath.addList(path);
+    }
+
 #   include "call_start.hpp"
 
-    std::optional<int> startGroup;
+    int startGroup = -1; // index of first argument of open group, if any
 
     try {
+	phase("preload");
+	auto preloaded =
+	  preloadObjects(argc, argv, numThreads, objectFile.strip);
+
+	phase("input");
 	for (int i = 0; i < argc; ++i) {
-	    if (!strcmp("-L", argv[i])) {
-		if (++i >= argc) {
-		    usage();
+	    if (!strcmp("-o", argv[i])) {
+		if (outFd >= 0) {
+		    close(outFd);
 		}
-		objectFile.libpath.insert(argv[i]);
+		outFd = open_executable(argv[++i]);
 		continue;
 	    }
-	    if (!strncmp("-L", argv[i], 2)) {
-		objectFile.libpath.insert(argv[i] + 2);
-		continue;
-	    }
-	}
-
-	for (int i = 0; i < argc; ++i) {
-	    if (!strcmp("-o", argv[i])) {
-		pOut = open_executable(argv[++i]);
+	    if (!strcmp("--image", argv[i])) {
+		imageOutput = true;
 		continue;
 	    }
 	    if (!strcmp("-textseg", argv[i])) {
@@ -919,47 +1418,89 @@ main(int argc, char **argv)
 	    if (!strncmp("-L", argv[i], 2)) {
 		continue;
 	    }
+	    if (!strncmp("--threads=", argv[i], 10) || !strcmp("-s", argv[i]) ||
+		!strcmp("--stats", argv[i]) ||
+		!strncmp("--stats=", argv[i], 8) ||
+		!strncmp("--trace=", argv[i], 8) ||
+		!strcmp("--counters", argv[i]))
+	    {
+		continue;
+	    }
 	    if (!strcmp("--start-group", argv[i]) || !strcmp("-(", argv[i])) {
 		startGroup = i + 1;
 		continue;
 	    }
 	    if (!strcmp("--end-group", argv[i]) || !strcmp("-)", argv[i])) {
-		if (!startGroup.has_value()) {
+		if (startGroup < 0) {
+		    abortLink();
 		    std::cerr << cmdname << ": missing --start-group or -("
 			      << std::endl;
 		    return 1;
 		}
-		do {
-		    int resolved = 0;
-		    for (int g = startGroup.value(); g < i; ++g) {
-			resolved +=
-			  objectFile.addLibOrObject(argv[g], true) > 0;
-		    }
-		    if (!resolved) {
-			break;
-		    }
-		} while (true);
-		//startGroup.reset(); TODO: gcc bug? Gives warning ...
+		objectFile.resolveFromGroup(
+		  std::vector<std::string>(argv + startGroup, argv + i));
+		startGroup = -1;
+		continue;
+	    }
+	    if (preloaded[i].error) {
+		std::rethrow_exception(preloaded[i].error);
+	    }
+	    if (preloaded[i].object) {
+		++objectFile.numFiles;
+		objectFile.addObject(*preloaded[i].object);
+		preloaded[i].object.reset();
 		continue;
 	    }
 	    objectFile.addLibOrObject(argv[i]);
 	}
-	if (startGroup.has_value()) {
+	if (startGroup >= 0) {
+	    abortLink();
 	    std::cerr << cmdname
 		      << ": --start-group not terminated with --end-group"
 		      << std::endl;
 	    return 1;
 	}
 
-	// std::ostream    &out = pOut ? *pOut : std::cout;
-	if (!pOut) {
-	    pOut = open_executable("a.out");
+	if (outFd < 0) {
+	    outFd = open_executable("a.out");
+	}
+	phase("layout");
+	objectFile.layout();
+
+	phase("fixups");
+	objectFile.applyFixups();
+
+	phase("output");
+	io::output_buffer out(outFd);
+	if (imageOutput) {
+	    objectFile.writeImage(out, ulm);
+	} else {
+	    objectFile.print(out, ulm, objectFile.strip);
+	}
+	if (!out.flush() || close(outFd) < 0) {
+	    throw Exception("can not write " + executables.back());
+	}
+	report.stop();
+	phaseSpan.reset();
+	writeTrace(traceFile);
+
+	if (withStats) {
+	    objectFile.addCounts(report);
+	    report.count("output_bytes", out.bytes_written());
+	    if (statsFile.empty()) {
+		report.write_json(std::cerr);
+	    } else {
+		std::ofstream statsOut(statsFile);
+		report.write_json(statsOut);
+		if (!statsOut.flush()) {
+		    std::cerr << cmdname << ": can not write " << statsFile
+			      << std::endl;
+		    return 1;
+		}
+	    }
 	}
-	std::ostream &out{ *pOut };
-	objectFile.link();
-	objectFile.print(out, ulm, false);
     } catch (Exception &e) {
-	delete_executable();
+	abortLink();
 	std::cerr << cmdname << ": execution aborted" << std::endl
 		  << e.what() << std::endl;
 	std::exit(1);
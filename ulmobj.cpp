@@ -0,0 +1,53 @@
+/*
+   Converts a textual object file into a binary one (see ParsedObject in
+   parsed-object.hpp) which ulmld reads without parsing. Binary objects
+   can be put into archives like textual ones.
+*/
+
+#include <cstdlib>
+#include <string>
+#include <printf.hpp>
+#include "mapped-file.hpp"
+#include "output-buffer.hpp"
+#include "parsed-object.hpp"
+
+/* POSIX headers */
+#include <fcntl.h>
+#include <unistd.h>
+
+int
+main(int argc, char** argv)
+{
+    const char *cmdname = *argv++; --argc;
+    if (argc != 2) {
+	fmt::printf(std::cerr, "Usage: %s infile outfile\n", cmdname);
+	std::exit(1);
+    }
+    const char *infile = argv[0];
+    const char *outfile = argv[1];
+
+    ParsedObject object;
+    if (!object.mapping.open(infile)) {
+	fmt::printf(std::cerr, "%s: can not open %s\n", cmdname, infile);
+	std::exit(1);
+    }
+    try {
+	object.read(object.mapping.contents(), infile);
+    } catch (Exception &e) {
+	fmt::printf(std::cerr, "%s: %s\n", cmdname, e.what());
+	std::exit(1);
+    }
+
+    int fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+	fmt::printf(std::cerr, "%s: can not create %s\n", cmdname, outfile);
+	std::exit(1);
+    }
+    io::output_buffer out(fd);
+    object.writeBinary(out);
+    if (!out.flush() || close(fd) < 0) {
+	fmt::printf(std::cerr, "%s: can not write %s\n", cmdname, outfile);
+	std::remove(outfile);
+	std::exit(1);
+    }
+}
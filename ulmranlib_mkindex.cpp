@@ -1,9 +1,140 @@
+/*
+   Prints the index of an archive of ULM object files which is to be
+   stored as __SYMTAB_INDEX member. By default the index is textual,
+   with -b the binary hashed index of archive-index.hpp is written.
+
+   Members are scanned in parallel by --threads=N threads (default:
+   number of available cores); the index lists them in archive order
+   independent of this setting.
+
+   The textual index starts the entries of each member with a line
+
+      # member mtime size checksum name
+
+   (ignored by ulmld as comment). If the archive carries such an index
+   already, only members that were added or changed are scanned, the
+   entries of all other members are taken from the previous index. A
+   member is considered unchanged without reading it if its size and
+   mtime match and it is not newer than the previous index. Deterministic
+   archives record an mtime of 0; for their members the checksum of
+   codec::checksum_64() decides instead (it is 0 for all other members).
+   The binary index keeps just the first definition of each symbol and is
+   therefore not reused; -f forces a full scan without any checksums.
+*/
+
+#include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <cstdlib>
-#include <sstream>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <printf.hpp>
+#include "archive-index.hpp"
 #include "archive-reader.hpp"
+#include "binary-codec.hpp"
+#include "parallel-for.hpp"
+#include "parsed-object.hpp"
+#include "text-scanner.hpp"
+
+/* a symbol defined by a member, ident refers to the mapped archive */
+struct Entry
+{
+    char kind;
+    std::string_view ident;
+};
+
+/* entries of a member and its identification from a previous index */
+struct IndexedMember
+{
+    std::uint64_t mtime, size, checksum;
+    std::vector<Entry> entries;
+};
+
+using PreviousIndex = std::unordered_map<std::string_view, IndexedMember>;
+
+/* returns nothing if the index has no member lines or is inconsistent */
+PreviousIndex
+readPreviousIndex(std::string_view text)
+{
+    PreviousIndex index;
+    std::string_view line;
+    std::string_view name;
+    IndexedMember *current = nullptr;
+    while (scan::next_line(text, line)) {
+	scan::skip_space(line);
+	if (scan::starts_with(line, "# member ")) {
+	    line.remove_prefix(9);
+	    IndexedMember member;
+	    if (!scan::parse_dec(line, member.mtime) ||
+		!scan::parse_dec(line, member.size) ||
+		!scan::parse_hex(line, member.checksum))
+	    {
+		return PreviousIndex();
+	    }
+	    scan::skip_space(line);
+	    name = line;
+	    current = &(index[name] = member);
+	    continue;
+	}
+	if (line.empty() || line[0] == '#') {
+	    continue;
+	}
+	char kind = line[0];
+	line.remove_prefix(1);
+	std::string_view ident = scan::next_token(line);
+	scan::skip_space(line);
+	if (!current || line != name) {
+	    return PreviousIndex();
+	}
+	current->entries.push_back({ kind, ident });
+    }
+    return index;
+}
+
+/* throws Exception for corrupt binary members */
+std::vector<Entry>
+scanMember(std::string_view contents, std::string_view name)
+{
+    std::vector<Entry> entries;
+    auto add = [&](char kind, std::string_view ident) {
+	if (std::isupper(kind) && (kind != 'U')) {
+	    entries.push_back({ kind, ident });
+	}
+    };
+
+    if (ParsedObject::isBinary(contents)) {
+	ParsedObject object;
+	object.read(contents, std::string(name));
+	for (auto& sym: object.symbols) {
+	    add(sym.kind, sym.ident);
+	}
+	return entries;
+    }
+
+    std::string_view line;
+    while (scan::next_line(contents, line)) {
+	if (line != "#SYMTAB") {
+	    continue;
+	}
+	while (scan::next_line(contents, line) && line != "#FIXUPS") {
+	    scan::skip_space(line);
+	    if (line.empty()) {
+		continue;
+	    }
+	    char kind = line[0];
+	    line.remove_prefix(1);
+	    add(kind, scan::next_token(line));
+	}
+	break;
+    }
+    return entries;
+}
 
 int
 main(int argc, char** argv)
@@ -11,46 +142,109 @@ main(int argc, char** argv)
     using namespace ar;
 
     const char *cmdname = *argv++; --argc;
+    bool binary = false;
+    bool full = false;
+    unsigned numThreads = par::default_concurrency();
+    for (; argc > 0 && **argv == '-'; ++argv, --argc) {
+	if (!std::strcmp(*argv, "-b")) {
+	    binary = true;
+	} else if (!std::strcmp(*argv, "-f")) {
+	    full = true;
+	} else if (!std::strncmp(*argv, "--threads=", 10)) {
+	    numThreads = std::max(std::atoi(*argv + 10), 1);
+	} else {
+	    break;
+	}
+    }
     if (argc != 1) {
-	fmt::printf(std::cerr, "Usage: %s archive\n", cmdname);
+	fmt::printf(std::cerr, "Usage: %s [-b] [-f] [--threads=N] archive\n",
+		    cmdname);
 	std::exit(1);
     }
 
     archive_reader archive(*argv);
-    if (archive.is_open()) {
-	archive_stream in(archive);
+    if (!archive.is_open()) {
+	fmt::printf(std::cerr, "%s: could not open as archive: %s\n",
+		    cmdname, *argv);
+	std::exit(1);
+    }
 
-	for (auto& member: archive) {
-	    if (member.name == "__SYMTAB_INDEX") {
-		continue;
+    std::vector<const archive_reader::member *> members;
+    for (auto& member: archive) {
+	if (member.name != "__SYMTAB_INDEX") {
+	    members.push_back(&member);
+	}
+    }
+
+    PreviousIndex previous;
+    std::uint64_t indexTime = 0;
+    if (auto indexMember = archive.find("__SYMTAB_INDEX"); indexMember &&
+	!full && !binary)
+    {
+	previous = readPreviousIndex(
+	  std::string_view(indexMember->data(), indexMember->size));
+	indexTime = indexMember->mtime;
+    }
+
+    std::vector<std::vector<Entry>> entries(members.size());
+    std::vector<std::uint64_t> checksums(members.size());
+    std::vector<std::exception_ptr> errors(members.size());
+    par::parallel_for(members.size(), numThreads, [&](std::size_t i) {
+	const auto &member = *members[i];
+	std::string_view contents(member.data(), member.size);
+	std::uint64_t mtime = member.mtime;
+	auto it = previous.find(member.name);
+	bool known = it != previous.end() && it->second.size == member.size &&
+		     it->second.mtime == mtime;
+	if (known && mtime != 0 && mtime <= indexTime) {
+	    checksums[i] = it->second.checksum;
+	    entries[i] = it->second.entries;
+	    return;
+	}
+	if (!binary && !full && mtime == 0) {
+	    checksums[i] = codec::checksum_64(contents);
+	    if (known && checksums[i] == it->second.checksum) {
+		entries[i] = it->second.entries;
+		return;
 	    }
-	    in.open(member.name);
-
-	    std::string line;
-	    while (std::getline(in, line)) {
-		if (line != "#SYMTAB") {
-		    continue;
-		}
-		while (std::getline(in, line)) {
-		    char	    kind;
-		    std::string	    ident, addr;
-
-		    std::istringstream(line) >> kind >> ident >> addr;
-		    if (line == "#FIXUPS") {
-			break;
-		    }
-		    if (std::isupper(kind) && (kind != 'U')) {
-			std::cout << kind << " "
-			    << std::setw (27) << std::left << ident << " "
-			    << member.name << std::endl;
-		    }
-		}
-		break;
+	}
+	try {
+	    entries[i] = scanMember(contents, member.name);
+	} catch (...) {
+	    errors[i] = std::current_exception();
+	}
+    });
+
+    arindex::builder index;
+    for (std::size_t i = 0; i < members.size(); ++i) {
+	if (errors[i]) {
+	    try {
+		std::rethrow_exception(errors[i]);
+	    } catch (std::exception &e) {
+		fmt::printf(std::cerr, "%s: %s\n", cmdname, e.what());
+		std::exit(1);
 	    }
 	}
-    } else {
-	fmt::printf(std::cerr, "%s: could not open as archive: %s\n",
-		    cmdname, *argv);
-	std::exit(1);
+	const auto &member = *members[i];
+	auto memberIndex = index.add_member(member.name,
+					    archive.offset_of(member),
+					    member.size);
+	if (!binary) {
+	    fmt::printf(std::cout, "# member %d %d %016x %s\n",
+			std::uint64_t(member.mtime), member.size, checksums[i],
+			member.name);
+	}
+	for (auto& entry: entries[i]) {
+	    if (binary) {
+		index.add_symbol(entry.ident, memberIndex);
+	    } else {
+		std::cout << entry.kind << " "
+		    << std::setw (27) << std::left << entry.ident << " "
+		    << member.name << '\n';
+	    }
+	}
+    }
+    if (binary) {
+	std::cout << index.data();
     }
 }